@@ -0,0 +1,125 @@
+// Keyspace table microbenchmark: inserts, hit and miss lookups in random order, and memory
+// per key for KeyTable next to the std::unordered_map<std::string, std::string> it replaced.
+// Both hold the same small string keys and values; the map's bytes are counted through its
+// allocator, the table's are what it reports for INFO memory.
+//   usage: keytable_bench [keys]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "KeyTable.hpp"
+#include "EpochManager.hpp"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    double nsPerOp(Clock::time_point start, size_t ops) {
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ops;
+    }
+
+    size_t mapBytes = 0;  // held by the baseline map's allocator
+
+    template <typename T>
+    struct CountingAllocator {
+        using value_type = T;
+        CountingAllocator() = default;
+        template <typename U>
+        CountingAllocator(const CountingAllocator<U>&) {}
+        T* allocate(size_t n) {
+            mapBytes += n * sizeof(T);
+            return std::allocator<T>().allocate(n);
+        }
+        void deallocate(T* ptr, size_t n) {
+            mapBytes -= n * sizeof(T);
+            std::allocator<T>().deallocate(ptr, n);
+        }
+        template <typename U>
+        bool operator==(const CountingAllocator<U>&) const { return true; }
+    };
+
+    using BaselineMap = std::unordered_map<std::string, std::string, std::hash<std::string>,
+        std::equal_to<std::string>, CountingAllocator<std::pair<const std::string, std::string>>>;
+
+    void report(const char* name, double insertNs, double hitNs, double missNs, size_t bytes, size_t keys) {
+        std::printf("%-14s insert %6.1f ns  hit %6.1f ns  miss %6.1f ns  %6.1f bytes/key\n",
+                    name, insertNs, hitNs, missNs, static_cast<double>(bytes) / keys);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t keys = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    if (keys == 0) {
+        std::fprintf(stderr, "usage: %s [keys]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<std::string> present;
+    std::vector<std::string> absent;
+    present.reserve(keys);
+    absent.reserve(keys);
+    for (size_t i = 0; i < keys; i++) {
+        present.push_back("key:" + std::to_string(i));
+        absent.push_back("nokey:" + std::to_string(i));
+    }
+    const std::string value = "value:12";  // short enough to sit inline in either
+
+    std::vector<size_t> order(keys);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937_64(42));
+    std::printf("%zu keys\n", keys);
+
+    size_t found = 0;
+    {
+        KeyTable table;
+        auto start = Clock::now();
+        for (size_t i : order) {
+            const std::string& key = present[i];
+            table.insert(new KeyNode{KeyHash{}(key), SlabString(key), Entry{StringValue(value)}});
+        }
+        double insertNs = nsPerOp(start, keys);
+
+        EpochGuard guard;  // as a lock-free reader would
+        start = Clock::now();
+        for (size_t i : order) {
+            found += table.find(present[i], KeyHash{}(present[i])) != nullptr;
+        }
+        double hitNs = nsPerOp(start, keys);
+        start = Clock::now();
+        for (size_t i : order) {
+            found += table.find(absent[i], KeyHash{}(absent[i])) != nullptr;
+        }
+        double missNs = nsPerOp(start, keys);
+        report("KeyTable", insertNs, hitNs, missNs, table.tableBytes() + table.nodeBytes(), keys);
+    }
+    {
+        BaselineMap map;
+        auto start = Clock::now();
+        for (size_t i : order) {
+            map.emplace(present[i], value);
+        }
+        double insertNs = nsPerOp(start, keys);
+
+        start = Clock::now();
+        for (size_t i : order) {
+            found += map.find(present[i]) != map.end();
+        }
+        double hitNs = nsPerOp(start, keys);
+        start = Clock::now();
+        for (size_t i : order) {
+            found += map.find(absent[i]) != map.end();
+        }
+        double missNs = nsPerOp(start, keys);
+        report("unordered_map", insertNs, hitNs, missNs, mapBytes, keys);
+    }
+
+    if (found != 2 * keys) {
+        std::fprintf(stderr, "found %zu keys, expected %zu\n", found, 2 * keys);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,91 @@
+// RESP parser microbenchmark: parses a pipelined buffer of small SET/GET commands, the
+// traffic where protocol framing dominates, and times the CR scan on its own against the
+// std::string::find("\r\n") it replaced.
+//   usage: parser_bench [commands]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include "resp_parser.hpp"
+#include "crlf_scan.hpp"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    double secondsSince(Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    void appendCommand(std::string& out, std::initializer_list<std::string_view> args) {
+        out.append("*").append(std::to_string(args.size())).append("\r\n");
+        for (std::string_view arg : args) {
+            out.append("$").append(std::to_string(arg.size())).append("\r\n");
+            out.append(arg).append("\r\n");
+        }
+    }
+
+    // the whole buffer through one parser, as a connection would see a deep pipeline
+    void benchParse(const std::string& input, size_t commands, int rounds) {
+        size_t parsed = 0;
+        size_t args = 0;
+        auto start = Clock::now();
+        for (int round = 0; round < rounds; round++) {
+            RESPParser parser;
+            CommandArgs argv;
+            while (parser.parse(input, argv) == ParseStatus::Ok) {
+                parsed++;
+                args += argv.size();
+            }
+        }
+        double seconds = secondsSince(start);
+        if (parsed != commands * rounds) {
+            std::fprintf(stderr, "parsed %zu commands, expected %zu\n", parsed, commands * rounds);
+            std::exit(1);
+        }
+        std::printf("parse       %8.1f ns/command  %8.1f MB/s  (%zu args per round)\n",
+                    seconds * 1e9 / parsed, input.size() * rounds / seconds / 1e6, args / rounds);
+    }
+
+    // every CRLF in the buffer, found one after the other
+    template <typename Find>
+    void benchScan(const char* name, const std::string& input, int rounds, Find find) {
+        size_t found = 0;
+        auto start = Clock::now();
+        for (int round = 0; round < rounds; round++) {
+            for (size_t pos = find(input, 0); pos != std::string::npos; pos = find(input, pos + 2)) {
+                found++;
+            }
+        }
+        double seconds = secondsSince(start);
+        std::printf("%-11s %8.1f ns/line     %8.1f MB/s\n", name, seconds * 1e9 / found,
+                    input.size() * rounds / seconds / 1e6);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t commands = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    if (commands == 0) {
+        std::fprintf(stderr, "usage: %s [commands]\n", argv[0]);
+        return 1;
+    }
+
+    std::string input;
+    for (size_t i = 0; i < commands; i++) {
+        std::string key = "key:" + std::to_string(i);
+        if (i % 2) appendCommand(input, {"SET", key, "value:" + std::to_string(i)});
+        else appendCommand(input, {"GET", key});
+    }
+    const int rounds = 20;
+    std::printf("%zu commands, %zu bytes, cr scan kernel: %s\n", commands, input.size(), crScanKernel());
+
+    benchParse(input, commands, rounds);
+    benchScan("findCR", input, rounds, [](const std::string& s, size_t from) {
+        const char* cr = findCR(s.data() + from, s.data() + s.size());
+        return cr ? static_cast<size_t>(cr - s.data()) : std::string::npos;
+    });
+    benchScan("string find", input, rounds, [](const std::string& s, size_t from) {
+        return s.find("\r\n", from);
+    });
+    return 0;
+}
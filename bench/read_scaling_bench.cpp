@@ -0,0 +1,88 @@
+// Read scaling microbenchmark: GET throughput against the shared keyspace as reader threads
+// are added. Readers take no lock, so on a machine with the cores the total should grow
+// with the thread count instead of flattening out.
+//   usage: read_scaling_bench [max threads] [keys]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "DB.hpp"
+
+namespace {
+    constexpr size_t GETS_PER_THREAD = 2000000;
+
+    // every thread reads its own random sequence of existing keys; returns GETs per second
+    double runReaders(DB& db, const std::vector<std::string>& keys, size_t threads) {
+        std::atomic<size_t> hits{0};
+        std::atomic<bool> go{false};
+        std::vector<std::thread> readers;
+        for (size_t t = 0; t < threads; t++) {
+            readers.emplace_back([&db, &keys, &hits, &go, t] {
+                std::mt19937_64 rng(t + 1);
+                size_t found = 0;
+                while (!go.load(std::memory_order_acquire)) {
+                    std::this_thread::yield();
+                }
+                for (size_t i = 0; i < GETS_PER_THREAD; i++) {
+                    found += db.get(keys[rng() % keys.size()]).has_value();
+                }
+                hits.fetch_add(found);
+            });
+        }
+        auto start = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (hits.load() != threads * GETS_PER_THREAD) {
+            std::fprintf(stderr, "%zu of %zu GETs missed\n", threads * GETS_PER_THREAD - hits.load(),
+                         threads * GETS_PER_THREAD);
+            std::exit(1);
+        }
+        return threads * GETS_PER_THREAD / seconds;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t maxThreads = argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+                                 : std::max(1u, std::thread::hardware_concurrency());
+    size_t keyCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+    if (maxThreads == 0 || keyCount == 0) {
+        std::fprintf(stderr, "usage: %s [max threads] [keys]\n", argv[0]);
+        return 1;
+    }
+
+    // the DB loads dump.rdb when created and saves it at exit: start it in an empty scratch
+    // directory, and leave with _Exit below so nothing is written
+    char scratch[] = "/tmp/read_scaling_bench.XXXXXX";
+    if (!mkdtemp(scratch) || chdir(scratch) != 0) {
+        std::perror("scratch directory");
+        return 1;
+    }
+    DB& db = DB::getInstance();
+    std::vector<std::string> keys;
+    keys.reserve(keyCount);
+    for (size_t i = 0; i < keyCount; i++) {
+        keys.push_back("key:" + std::to_string(i));
+        db.set(keys.back(), "value:" + std::to_string(i));
+    }
+    std::printf("%zu keys, %zu GETs per thread, %u cores\n", keyCount, GETS_PER_THREAD,
+                std::thread::hardware_concurrency());
+
+    double single = 0;
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        double rate = runReaders(db, keys, threads);
+        if (threads == 1) single = rate;
+        std::printf("%3zu threads  %10.0f GET/s  %5.2fx\n", threads, rate, rate / single);
+    }
+    std::fflush(stdout);
+    rmdir(scratch);
+    std::_Exit(0);
+}
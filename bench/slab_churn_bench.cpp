@@ -0,0 +1,91 @@
+// Allocator churn microbenchmark: SET/DEL-style churn of small keyspace objects through
+// SlabAllocator next to plain operator new/delete. Each thread keeps a window of live
+// objects of mixed sizes and keeps freeing a random one and allocating its replacement.
+//   usage: slab_churn_bench [threads]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+#include "SlabAllocator.hpp"
+
+namespace {
+    constexpr size_t LIVE_OBJECTS = 100000;  // per thread
+    constexpr size_t OPERATIONS = 5000000;   // per thread, each one free plus one allocation
+
+    struct SlabHeap {
+        static void* allocate(size_t bytes) { return SlabAllocator::allocate(bytes); }
+        static void deallocate(void* ptr, size_t bytes) { SlabAllocator::deallocate(ptr, bytes); }
+    };
+
+    struct DefaultHeap {
+        static void* allocate(size_t bytes) { return ::operator new(bytes); }
+        static void deallocate(void* ptr, size_t bytes) { ::operator delete(ptr, bytes); }
+    };
+
+    // sizes of nodes, keys and short raw values, weighted towards the small end
+    size_t objectSize(std::mt19937_64& rng) {
+        return 16 + (rng() % 8 == 0 ? rng() % 496 : rng() % 112);
+    }
+
+    template <typename Heap>
+    void churn(uint64_t seed) {
+        std::mt19937_64 rng(seed);
+        std::vector<std::pair<void*, size_t>> live(LIVE_OBJECTS);
+        for (auto& [ptr, size] : live) {
+            size = objectSize(rng);
+            ptr = Heap::allocate(size);
+            std::memset(ptr, 0, size);  // touch it, as a real value would
+        }
+        for (size_t i = 0; i < OPERATIONS; i++) {
+            auto& [ptr, size] = live[rng() % LIVE_OBJECTS];
+            Heap::deallocate(ptr, size);
+            size = objectSize(rng);
+            ptr = Heap::allocate(size);
+            std::memset(ptr, 0, size);
+        }
+        for (auto& [ptr, size] : live) {
+            Heap::deallocate(ptr, size);
+        }
+    }
+
+    // ns per free+allocate pair, averaged over all threads' operations
+    template <typename Heap>
+    double run(size_t threads) {
+        std::vector<std::thread> workers;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t t = 0; t < threads; t++) {
+            workers.emplace_back(churn<Heap>, t + 1);
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        return ns / (threads * OPERATIONS);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t maxThreads = argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+                                 : std::max(1u, std::thread::hardware_concurrency());
+    if (maxThreads == 0) {
+        std::fprintf(stderr, "usage: %s [threads]\n", argv[0]);
+        return 1;
+    }
+    std::printf("%zu live objects and %zu churn operations per thread, %u cores\n",
+                LIVE_OBJECTS, OPERATIONS, std::thread::hardware_concurrency());
+
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        double slab = run<SlabHeap>(threads);
+        double heap = run<DefaultHeap>(threads);
+        std::printf("%3zu threads  slab %6.1f ns/op  operator new %6.1f ns/op\n", threads, slab, heap);
+    }
+
+    SlabAllocator::Stats stats = SlabAllocator::stats();
+    std::printf("slab reserved %zu KB, free on central lists %zu KB, large %zu KB\n",
+                stats.reserved / 1024, stats.centralFree / 1024, stats.large / 1024);
+    return 0;
+}
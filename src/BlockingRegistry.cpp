@@ -0,0 +1,188 @@
+#include "BlockingRegistry.hpp"
+#include "DB.hpp"
+#include "MasterServer.hpp"
+#include "reply_builder.hpp"
+#include <algorithm>
+#include <iostream>
+#include <shared_mutex>
+
+BlockingRegistry& BlockingRegistry::getInstance() {
+    static BlockingRegistry instance;  // singleton
+    return instance;
+}
+
+std::vector<std::string>& BlockingRegistry::readyKeys() {
+    thread_local std::vector<std::string> keys;
+    return keys;
+}
+
+std::optional<std::string> BlockingRegistry::popOne(std::string_view key, bool fromHead) {
+    DB& db = DB::getInstance();
+    std::vector<std::string> popped = fromHead ? db.lpop(key) : db.rpop(key);
+    if (popped.empty()) return std::nullopt;
+    return std::move(popped.front());
+}
+
+std::optional<std::pair<std::string, std::string>> BlockingRegistry::popOrBlock(Connection& client,
+    std::span<const std::string_view> keys, bool fromHead) {
+    // Counted as blocked before the lists are checked: a push that lands after the check
+    // is then sure to see a non-zero count and signal its key.
+    blockedCount_.fetch_add(1);
+    std::lock_guard<std::mutex> lock(mutex_);
+    try {
+        for (std::string_view key : keys) {
+            if (std::optional<std::string> element = popOne(key, fromHead)) {
+                blockedCount_.fetch_sub(1);
+                return std::make_pair(std::string(key), std::move(*element));
+            }
+        }
+    } catch (...) {
+        blockedCount_.fetch_sub(1);
+        throw;
+    }
+
+    auto waiter = std::make_shared<Waiter>(Waiter{client.id, client.fd, client.loop, fromHead,
+                                                   std::vector<std::string>(keys.begin(), keys.end())});
+    for (const std::string& key : waiter->keys) {
+        waitersByKey_[key].push_back(waiter);
+    }
+    waitersByClient_.emplace(client.id, std::move(waiter));
+    client.blocked = true;
+    return std::nullopt;
+}
+
+void BlockingRegistry::armTimeout(Connection& client, std::chrono::milliseconds timeout) {
+    EventLoop* loop = client.loop;
+    int fd = client.fd;
+    uint64_t id = client.id;
+    client.blockTimer = loop->runAfter(timeout, [loop, fd, id] {
+        if (!getInstance().unblock(id)) return;  // served meanwhile; its reply is on the way
+        Connection* conn = loop->findConnection(fd, id);
+        if (!conn) return;
+        conn->blocked = false;
+        conn->blockTimer = 0;
+        ReplyBuilder(conn->writeBuffer).nullArray();
+        loop->resumeConnection(*conn);
+    });
+}
+
+void BlockingRegistry::clientClosed(Connection& client) {
+    if (!client.blocked) return;
+    unblock(client.id);
+    if (client.blockTimer) client.loop->cancelTimer(client.blockTimer);
+}
+
+bool BlockingRegistry::unblock(uint64_t clientId) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = waitersByClient_.find(clientId);
+    if (it == waitersByClient_.end()) return false;
+    removeLocked(*it->second);
+    return true;
+}
+
+void BlockingRegistry::removeLocked(const Waiter& waiter) {
+    uint64_t clientId = waiter.clientId;  // waiter may die with its last queue entry
+    for (const std::string& key : waiter.keys) {
+        auto it = waitersByKey_.find(key);
+        if (it == waitersByKey_.end()) continue;  // key listed twice
+        auto& queue = it->second;
+        queue.erase(std::remove_if(queue.begin(), queue.end(),
+                        [clientId](const std::shared_ptr<Waiter>& w) { return w->clientId == clientId; }),
+                    queue.end());
+        if (queue.empty()) waitersByKey_.erase(it);
+    }
+    waitersByClient_.erase(clientId);
+    blockedCount_.fetch_sub(1);
+}
+
+void BlockingRegistry::signalKeyReady(std::string_view key) {
+    if (blockedCount_.load() == 0) return;
+    readyKeys().emplace_back(key);
+}
+
+void BlockingRegistry::serveReadyKeys(MasterServer* master) {
+    std::vector<std::string>& ready = readyKeys();
+    if (ready.empty()) return;
+    std::vector<std::string> keys;
+    keys.swap(ready);
+
+    struct Served {
+        std::shared_ptr<Waiter> waiter;
+        std::string key;
+        std::string element;
+    };
+    std::vector<Served> served;  // one per hand-off
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const std::string& key : keys) {
+            auto it = waitersByKey_.find(key);
+            while (it != waitersByKey_.end()) {
+                std::shared_ptr<Waiter> waiter = it->second.front();
+                std::optional<std::string> element;
+                try {
+                    element = popOne(key, waiter->fromHead);
+                } catch (const std::exception&) {
+                    break;  // key was overwritten with a non-list; waiters keep waiting
+                }
+                if (!element) break;
+                removeLocked(*waiter);
+                served.push_back({std::move(waiter), key, std::move(*element)});
+                it = waitersByKey_.find(key);
+            }
+        }
+    }
+
+    // each pop goes out before its delivery is posted, so a push-back by deliver() can't
+    // reach replicas ahead of the pop it undoes
+    for (Served& hand : served) {
+        if (master) {
+            CommandArgs pop{hand.waiter->fromHead ? "LPOP" : "RPOP", hand.key};
+            master->propagateWrite(pop);
+        }
+        deliver(*hand.waiter, std::move(hand.key), std::move(hand.element), master);
+    }
+}
+
+void BlockingRegistry::deliver(const Waiter& waiter, std::string key, std::string element,
+                               MasterServer* master) {
+    EventLoop* loop = waiter.loop;
+    int fd = waiter.fd;
+    uint64_t id = waiter.clientId;
+    bool fromHead = waiter.fromHead;
+    loop->post([loop, fd, id, fromHead, master, key = std::move(key), element = std::move(element)] {
+        Connection* conn = loop->findConnection(fd, id);
+        if (!conn) {
+            // gone before the hand-off: put the element back where it came from and offer it
+            // to the next waiter, as if the pop had never happened
+            std::shared_lock<std::shared_mutex> gate;
+            if (master) gate = master->lockWrites();
+            std::string_view value = element;
+            try {
+                if (fromHead) {
+                    DB::getInstance().lpush(key, std::span<const std::string_view>(&value, 1));
+                } else {
+                    DB::getInstance().rpush(key, std::span<const std::string_view>(&value, 1));
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Could not return element of disconnected blocked client: " << e.what() << "\n";
+                return;
+            }
+            if (master) {
+                CommandArgs push{fromHead ? "LPUSH" : "RPUSH", key, value};
+                master->propagateWrite(push);
+            }
+            BlockingRegistry& registry = getInstance();
+            registry.signalKeyReady(key);
+            registry.serveReadyKeys(master);
+            return;
+        }
+        conn->blocked = false;
+        if (conn->blockTimer) loop->cancelTimer(conn->blockTimer);
+        conn->blockTimer = 0;
+        ReplyBuilder reply(conn->writeBuffer);
+        reply.arrayHeader(2);
+        reply.bulkString(key);
+        reply.bulkString(element);
+        loop->resumeConnection(*conn);
+    });
+}
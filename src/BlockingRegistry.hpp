@@ -0,0 +1,86 @@
+#ifndef BLOCKING_REGISTRY_HPP
+#define BLOCKING_REGISTRY_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <chrono>
+#include "EventLoop.hpp"
+
+class MasterServer;
+
+// Clients parked by BLPOP/BRPOP, queued per key in arrival order.
+// A push never wakes anyone directly: the pushing thread signals the key, and once its
+// command has been propagated, serveReadyKeys() pops on behalf of the oldest waiters and
+// posts each reply to the waiter's own event loop. One pushed element wakes one client.
+// Waiters are only ever parked or served under mutex_, with the list's emptiness
+// re-checked first, so a push racing a client going to sleep can't be missed.
+class BlockingRegistry {
+public:
+    static BlockingRegistry& getInstance();
+
+    BlockingRegistry(const BlockingRegistry&) = delete;
+    BlockingRegistry& operator=(const BlockingRegistry&) = delete;
+
+    // BLPOP/BRPOP: pop from the first non-empty key, or park client on all of them.
+    // Returns {key, element} if something was popped straight away (the caller replies and
+    // propagates); nullopt means the client is now parked and marked blocked.
+    std::optional<std::pair<std::string, std::string>> popOrBlock(Connection& client,
+        std::span<const std::string_view> keys, bool fromHead);
+
+    // Release a parked client with a nil reply after timeout, unless served first.
+    // Loop thread only (the client's).
+    void armTimeout(Connection& client, std::chrono::milliseconds timeout);
+
+    // Connection close hook: forget the client if it is parked.
+    void clientClosed(Connection& client);
+
+    // Drop a parked client. False if it was already served.
+    bool unblock(uint64_t clientId);
+
+    // After a push to key: remember it for this thread's next serveReadyKeys().
+    // Free when nobody is blocked anywhere.
+    void signalKeyReady(std::string_view key);
+
+    // Hand elements on the keys this thread signalled to their waiters, oldest first,
+    // and propagate each hand-off as the LPOP/RPOP it amounts to (master may be null).
+    void serveReadyKeys(MasterServer* master);
+
+private:
+    struct Waiter {
+        uint64_t clientId;
+        int fd;
+        EventLoop* loop;
+        bool fromHead;
+        std::vector<std::string> keys;
+    };
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::deque<std::shared_ptr<Waiter>>> waitersByKey_;
+    std::unordered_map<uint64_t, std::shared_ptr<Waiter>> waitersByClient_;
+    std::atomic<size_t> blockedCount_{0};
+
+    BlockingRegistry() = default;
+
+    static std::vector<std::string>& readyKeys();  // per thread
+
+    // pop from key for a blocking command; nullopt if missing or empty
+    static std::optional<std::string> popOne(std::string_view key, bool fromHead);
+    // unlink waiter from every key queue and the client index; caller holds mutex_
+    void removeLocked(const Waiter& waiter);
+    // send "*2 key element" to waiter's connection on its loop and release it; if the client
+    // has gone by then, push element back onto key (propagating the push through master, which
+    // may be null) and serve the next waiter
+    static void deliver(const Waiter& waiter, std::string key, std::string element,
+                        MasterServer* master);
+};
+
+#endif // BLOCKING_REGISTRY_HPP
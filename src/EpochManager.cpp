@@ -0,0 +1,125 @@
+#include "EpochManager.hpp"
+#include <algorithm>
+
+// Per-thread side of the scheme: the announced-epoch record and this thread's limbo list.
+struct EpochManager::ThreadState {
+    ThreadRecord* record = nullptr;
+    int depth = 0;                  // nested EpochGuards
+    std::vector<Retired> limbo;     // retired here, not yet safe to free
+    size_t retiresSinceCollect = 0;
+
+    ~ThreadState() {
+        if (record) {
+            record->epoch.store(QUIESCENT, std::memory_order_release);
+            record->inUse.store(false, std::memory_order_release);
+        }
+        if (!limbo.empty()) {
+            // someone else frees them once it is safe
+            EpochManager::getInstance().adoptOrphans(std::move(limbo));
+        }
+    }
+};
+
+EpochManager& EpochManager::getInstance() {
+    static EpochManager instance;  // singleton
+    return instance;
+}
+
+// only reached at process exit, when no reader is left
+EpochManager::~EpochManager() {
+    for (const Retired& item : orphans_) {
+        item.deleter(item.ptr);
+    }
+    ThreadRecord* record = records_.load(std::memory_order_acquire);
+    while (record) {
+        ThreadRecord* next = record->next;
+        delete record;
+        record = next;
+    }
+}
+
+EpochManager::ThreadState& EpochManager::threadState() {
+    thread_local ThreadState state;
+    return state;
+}
+
+// reuse the record of an exited thread if there is one, else publish a new one
+EpochManager::ThreadRecord* EpochManager::acquireRecord() {
+    for (ThreadRecord* record = records_.load(std::memory_order_acquire); record; record = record->next) {
+        bool expected = false;
+        if (!record->inUse.load(std::memory_order_relaxed) &&
+            record->inUse.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+            return record;
+        }
+    }
+
+    ThreadRecord* record = new ThreadRecord;
+    record->inUse.store(true, std::memory_order_relaxed);
+    ThreadRecord* head = records_.load(std::memory_order_relaxed);
+    do {
+        record->next = head;
+    } while (!records_.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+    return record;
+}
+
+void EpochManager::enter() {
+    ThreadState& state = threadState();
+    if (state.depth++ > 0) return;
+    if (!state.record) state.record = acquireRecord();
+    // seq_cst so the announcement is visible before any pointer this reader loads
+    state.record->epoch.store(globalEpoch_.load(std::memory_order_relaxed), std::memory_order_seq_cst);
+}
+
+void EpochManager::exit() {
+    ThreadState& state = threadState();
+    if (--state.depth > 0) return;
+    state.record->epoch.store(QUIESCENT, std::memory_order_release);
+}
+
+void EpochManager::retire(void* ptr, void (*deleter)(void*)) {
+    ThreadState& state = threadState();
+    state.limbo.push_back({ptr, deleter, globalEpoch_.load(std::memory_order_seq_cst)});
+    pending_.fetch_add(1, std::memory_order_relaxed);
+
+    if (++state.retiresSinceCollect >= COLLECT_INTERVAL) {
+        state.retiresSinceCollect = 0;
+        tryAdvance();
+        collect(state.limbo);
+    }
+}
+
+bool EpochManager::tryAdvance() {
+    uint64_t current = globalEpoch_.load(std::memory_order_seq_cst);
+    for (ThreadRecord* record = records_.load(std::memory_order_acquire); record; record = record->next) {
+        uint64_t epoch = record->epoch.load(std::memory_order_seq_cst);
+        if (epoch != QUIESCENT && epoch != current) {
+            return false;  // a reader may still be using something unlinked in an older epoch
+        }
+    }
+    return globalEpoch_.compare_exchange_strong(current, current + 1, std::memory_order_seq_cst);
+}
+
+void EpochManager::collect(std::vector<Retired>& limbo) {
+    {
+        std::unique_lock<std::mutex> lock(orphanMutex_, std::try_to_lock);
+        if (lock.owns_lock() && !orphans_.empty()) {
+            limbo.insert(limbo.end(), orphans_.begin(), orphans_.end());
+            orphans_.clear();
+        }
+    }
+
+    // anything retired two epochs back was unlinked before every active reader started
+    uint64_t current = globalEpoch_.load(std::memory_order_seq_cst);
+    auto stillPending = std::partition(limbo.begin(), limbo.end(),
+        [current](const Retired& item) { return item.epoch + 2 > current; });
+    for (auto it = stillPending; it != limbo.end(); ++it) {
+        it->deleter(it->ptr);
+    }
+    pending_.fetch_sub(limbo.end() - stillPending, std::memory_order_relaxed);
+    limbo.erase(stillPending, limbo.end());
+}
+
+void EpochManager::adoptOrphans(std::vector<Retired>&& limbo) {
+    std::lock_guard<std::mutex> lock(orphanMutex_);
+    orphans_.insert(orphans_.end(), limbo.begin(), limbo.end());
+}
@@ -0,0 +1,87 @@
+#ifndef EPOCH_MANAGER_HPP
+#define EPOCH_MANAGER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// Epoch-based reclamation for data read without locks (the keyspace tables).
+// Readers wrap each access in an EpochGuard. Writers unlink an object first, then
+// retire() it instead of deleting it. The object is freed only once every thread that
+// could still hold a pointer to it has left its guard. Reader cost is two stores to a
+// thread-local cache line; all bookkeeping happens on the retire side.
+class EpochManager {
+public:
+    static EpochManager& getInstance();
+
+    EpochManager(const EpochManager&) = delete;
+    EpochManager& operator=(const EpochManager&) = delete;
+
+    // Free ptr with deleter once no reader can still see it. Call after unlinking.
+    void retire(void* ptr, void (*deleter)(void*));
+
+    template <typename T>
+    void retire(T* ptr) {
+        retire(ptr, [](void* p) { delete static_cast<T*>(p); });
+    }
+
+    // retired objects not yet freed, across all threads
+    size_t pendingCount() const { return pending_.load(std::memory_order_relaxed); }
+
+private:
+    friend class EpochGuard;
+
+    static constexpr uint64_t QUIESCENT = UINT64_MAX;  // thread is outside any guard
+    static constexpr size_t COLLECT_INTERVAL = 64;      // retires between reclamation attempts
+
+    // One per thread that has ever entered a guard; recycled when the thread exits.
+    struct alignas(64) ThreadRecord {
+        std::atomic<uint64_t> epoch{QUIESCENT};
+        std::atomic<bool> inUse{false};
+        ThreadRecord* next = nullptr;
+    };
+
+    struct Retired {
+        void* ptr;
+        void (*deleter)(void*);
+        uint64_t epoch;  // global epoch when it was unlinked
+    };
+
+    struct ThreadState;
+
+    std::atomic<uint64_t> globalEpoch_{1};
+    std::atomic<ThreadRecord*> records_{nullptr};  // push-only list, so scans need no lock
+    std::atomic<size_t> pending_{0};
+
+    std::mutex orphanMutex_;
+    std::vector<Retired> orphans_;  // limbo left behind by exited threads
+
+    EpochManager() = default;
+    ~EpochManager();
+
+    ThreadRecord* acquireRecord();
+    static ThreadState& threadState();
+
+    void enter();
+    void exit();
+
+    // bump the global epoch if every active reader has observed the current one
+    bool tryAdvance();
+    // free everything in limbo retired at least two epochs ago
+    void collect(std::vector<Retired>& limbo);
+    void adoptOrphans(std::vector<Retired>&& limbo);
+};
+
+// Marks the current thread as reading shared structures; nests freely.
+class EpochGuard {
+public:
+    EpochGuard() { EpochManager::getInstance().enter(); }
+    ~EpochGuard() { EpochManager::getInstance().exit(); }
+
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+};
+
+#endif // EPOCH_MANAGER_HPP
@@ -0,0 +1,352 @@
+#include "EventLoop.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define READ_CHUNK_SIZE 16384
+#define MAX_EVENTS 256
+
+namespace {
+    bool setNonBlocking(int fd) {
+        int flags = fcntl(fd, F_GETFL, 0);
+        if (flags < 0) return false;
+        return fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+    }
+
+    std::atomic<uint64_t> nextConnectionId{1};
+}
+
+EventLoop::EventLoop(ConnectionCallback onData, ConnectionCallback onAccept, ConnectionCallback onClose)
+    : epollFd_(epoll_create1(EPOLL_CLOEXEC)), wakeFd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      stopped_(false), onData_(std::move(onData)), onAccept_(std::move(onAccept)),
+      onClose_(std::move(onClose)) {
+    if (epollFd_ < 0 || wakeFd_ < 0) {
+        throw std::runtime_error("Failed to create epoll instance");
+    }
+    struct epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.ptr = this;  // wake fd (stop() and post()) is the only registration pointing at the loop itself
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &ev);
+}
+
+EventLoop::~EventLoop() {
+    for (auto& pair : connections_) {
+        close(pair.first);
+    }
+    connections_.clear();
+    close(wakeFd_);
+    close(epollFd_);
+}
+
+bool EventLoop::addListener(int listenFd) {
+    if (!setNonBlocking(listenFd)) {
+        std::cerr << "Failed to make listening socket non-blocking\n";
+        return false;
+    }
+    listenFds_.push_back(listenFd);
+    struct epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = &listenFds_.back();  // list nodes are stable, so the address identifies the listener
+    if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, listenFd, &ev) < 0) {
+        std::cerr << "Failed to register listening socket with epoll\n";
+        listenFds_.pop_back();
+        return false;
+    }
+    return true;
+}
+
+void EventLoop::stop() {
+    stopped_ = true;
+    uint64_t one = 1;
+    ssize_t ignored = write(wakeFd_, &one, sizeof(one));
+    (void)ignored;
+}
+
+EventLoop::TimerId EventLoop::runEvery(std::chrono::milliseconds interval, std::function<void()> fn) {
+    return addTimer(interval, interval, std::move(fn));
+}
+
+EventLoop::TimerId EventLoop::runAfter(std::chrono::milliseconds delay, std::function<void()> fn) {
+    return addTimer(delay, std::chrono::milliseconds(0), std::move(fn));
+}
+
+EventLoop::TimerId EventLoop::addTimer(std::chrono::milliseconds delay, std::chrono::milliseconds interval,
+                                       std::function<void()> fn) {
+    TimerId id = nextTimerId_++;
+    timers_.emplace(id, Timer{std::move(fn), interval});
+    timerQueue_.emplace(Clock::now() + delay, id);
+    return id;
+}
+
+void EventLoop::cancelTimer(TimerId id) {
+    timers_.erase(id);
+}
+
+int EventLoop::runTimers() {
+    auto now = Clock::now();
+    while (!timerQueue_.empty()) {
+        auto [due, id] = timerQueue_.top();
+        auto it = timers_.find(id);
+        if (it == timers_.end()) {
+            timerQueue_.pop();  // cancelled
+            continue;
+        }
+        if (due > now) {
+            return static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(due - now).count());
+        }
+        timerQueue_.pop();
+        if (it->second.interval.count() == 0) {
+            auto fn = std::move(it->second.fn);
+            timers_.erase(it);
+            fn();
+        } else {
+            auto interval = it->second.interval;
+            it->second.fn();  // may cancel itself
+            now = Clock::now();
+            if (timers_.count(id)) timerQueue_.emplace(now + interval, id);
+        }
+    }
+    return -1;
+}
+
+void EventLoop::post(std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lock(postMutex_);
+        posted_.push_back(std::move(fn));
+    }
+    uint64_t one = 1;
+    ssize_t ignored = write(wakeFd_, &one, sizeof(one));
+    (void)ignored;
+}
+
+void EventLoop::runPosted() {
+    std::vector<std::function<void()>> tasks;
+    {
+        std::lock_guard<std::mutex> lock(postMutex_);
+        tasks.swap(posted_);
+    }
+    for (auto& task : tasks) {
+        task();
+    }
+}
+
+Connection* EventLoop::findConnection(int fd, uint64_t id) {
+    auto it = connections_.find(fd);
+    if (it == connections_.end() || it->second->id != id) return nullptr;
+    return it->second.get();
+}
+
+void EventLoop::resumeConnection(Connection& conn) {
+    if (conn.state == Connection::State::Reading && !conn.readBuffer.empty()) {
+        onData_(conn);
+    }
+    if (!flushWrites(conn)) {
+        closeConnection(conn);
+        return;
+    }
+    if (conn.state == Connection::State::Closing && conn.writeOffset >= conn.writeBuffer.size()) {
+        closeConnection(conn);
+    }
+}
+
+void EventLoop::queueWrite(Connection& conn, std::string_view bytes) {
+    conn.writeBuffer.append(bytes);
+    if (!flushWrites(conn)) {
+        closeConnection(conn);
+    }
+}
+
+void EventLoop::run() {
+    struct epoll_event events[MAX_EVENTS];
+
+    while (!stopped_) {
+        int timeout = runTimers();
+        int n = epoll_wait(epollFd_, events, MAX_EVENTS, timeout);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "epoll_wait failed: " << strerror(errno) << "\n";
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == this) {
+                uint64_t value;
+                ssize_t ignored = read(wakeFd_, &value, sizeof(value));
+                (void)ignored;
+                runPosted();
+                continue;
+            }
+            bool isListener = false;
+            for (int& listenFd : listenFds_) {
+                if (events[i].data.ptr == &listenFd) {
+                    acceptConnections(listenFd);
+                    isListener = true;
+                    break;
+                }
+            }
+            if (!isListener) {
+                handleEvent(*static_cast<Connection*>(events[i].data.ptr), events[i].events);
+            }
+        }
+        // connections closed by this batch, its timers or posted tasks; no event refers to them now
+        closed_.clear();
+    }
+}
+
+void EventLoop::acceptConnections(int listenFd) {
+    while (true) {  // edge-triggered: accept until the backlog is empty
+        struct sockaddr_in clientAddr;
+        socklen_t addrLen = sizeof(clientAddr);
+        int clientFd = accept4(listenFd, (struct sockaddr *) &clientAddr, &addrLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (clientFd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                std::cerr << "TCP Handshake failed\n";
+            }
+            return;
+        }
+
+        int flag = 1;  // replies are already batched per read cycle
+        setsockopt(clientFd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+        auto conn = std::make_unique<Connection>(clientFd);
+        conn->id = nextConnectionId.fetch_add(1, std::memory_order_relaxed);
+        conn->loop = this;
+        char clientIP[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &(clientAddr.sin_addr), clientIP, INET_ADDRSTRLEN);
+        conn->peerIP = clientIP;
+        conn->peerPort = ntohs(clientAddr.sin_port);
+
+        struct epoll_event ev{};
+        // register for both directions once; with EPOLLET, EPOLLOUT only fires when the send buffer frees up
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = conn.get();
+        if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, clientFd, &ev) < 0) {
+            std::cerr << "Failed to register client socket with epoll\n";
+            close(clientFd);
+            continue;
+        }
+
+        Connection& ref = *conn;
+        connections_.emplace(clientFd, std::move(conn));
+        if (onAccept_) {
+            onAccept_(ref);
+        }
+    }
+}
+
+void EventLoop::handleEvent(Connection& conn, uint32_t events) {
+    if (conn.state == Connection::State::Closed) {
+        return;  // closed earlier in this batch, e.g. by a posted task
+    }
+    if (events & EPOLLERR) {
+        closeConnection(conn);
+        return;
+    }
+
+    // send buffer freed up: finish the pending write, then resume reading what queued up meanwhile
+    if ((events & EPOLLOUT) && conn.writeOffset < conn.writeBuffer.size()) {
+        bool wasWriting = conn.state == Connection::State::Writing;
+        if (!flushWrites(conn)) {
+            closeConnection(conn);
+            return;
+        }
+        if (wasWriting && conn.state == Connection::State::Reading) {
+            events |= EPOLLIN;
+        }
+    }
+
+    if ((events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) && conn.state == Connection::State::Reading) {
+        if (!readAvailable(conn)) {
+            closeConnection(conn);
+            return;
+        }
+        if (!conn.readBuffer.empty()) {
+            onData_(conn);
+        }
+        if (!flushWrites(conn)) {
+            closeConnection(conn);
+            return;
+        }
+    }
+
+    if (conn.state == Connection::State::Closing && conn.writeOffset >= conn.writeBuffer.size()) {
+        closeConnection(conn);
+    }
+}
+
+bool EventLoop::readAvailable(Connection& conn) {
+    char temp[READ_CHUNK_SIZE];
+    while (true) {  // edge-triggered: drain the socket until EAGAIN
+        ssize_t bytesReceived = recv(conn.fd, temp, sizeof(temp), 0);
+        if (bytesReceived > 0) {
+            conn.readBuffer.append(temp, bytesReceived);
+            continue;
+        }
+        if (bytesReceived == 0) {
+            conn.state = Connection::State::Closing;
+            return true;
+        }
+        if (errno == EINTR) continue;
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+}
+
+bool EventLoop::flushWrites(Connection& conn) {
+    while (conn.writeOffset < conn.writeBuffer.size()) {
+        ssize_t sent = send(conn.fd, conn.writeBuffer.data() + conn.writeOffset,
+                            conn.writeBuffer.size() - conn.writeOffset, MSG_NOSIGNAL);
+        if (sent > 0) {
+            conn.writeOffset += sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (conn.state == Connection::State::Reading) {
+                conn.state = Connection::State::Writing;  // stop reading until EPOLLOUT drains us
+            }
+            return true;
+        }
+        return false;
+    }
+    conn.writeBuffer.clear();
+    conn.writeOffset = 0;
+    if (conn.state == Connection::State::Writing) {
+        conn.state = Connection::State::Reading;
+    }
+    return true;
+}
+
+void EventLoop::closeConnection(Connection& conn) {
+    if (conn.state == Connection::State::Closed) return;
+    if (onClose_) {
+        onClose_(conn);
+    }
+    int fd = conn.fd;
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    conn.state = Connection::State::Closed;
+    // Events already returned by epoll_wait may still point at conn, and the fd number may be
+    // reused by an accept in the same batch, so conn moves out of connections_ now but is
+    // only destroyed once the batch is done
+    auto it = connections_.find(fd);
+    closed_.push_back(std::move(it->second));
+    connections_.erase(it);
+}
+
+bool pinThreadToCore(int core) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+}
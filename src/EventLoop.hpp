@@ -0,0 +1,131 @@
+#ifndef EVENT_LOOP_HPP
+#define EVENT_LOOP_HPP
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <atomic>
+#include <list>
+#include <vector>
+#include <queue>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include "resp_parser.hpp"
+
+// State for one client socket owned by an EventLoop.
+// Reading  -> socket is drained on every EPOLLIN edge and handed to the data callback
+// Writing  -> kernel send buffer is full; reads pause until EPOLLOUT drains writeBuffer
+// Closing  -> peer hung up; close as soon as queued replies are flushed
+// Closed   -> socket closed and unregistered; the object lingers until the current epoll
+//             batch is done, since later events in it may still point at it
+// A blocked connection (BLPOP and friends) keeps reading but runs no commands until released.
+class EventLoop;
+
+struct Connection {
+    enum class State { Reading, Writing, Closing, Closed };
+
+    int fd;
+    State state = State::Reading;
+    std::string readBuffer;     // received bytes not yet consumed by the parser
+    RESPParser parser;          // resumes mid-command across reads
+    std::string writeBuffer;    // queued replies not yet accepted by the kernel
+    size_t writeOffset = 0;     // bytes of writeBuffer already sent
+    std::string peerIP;
+    int peerPort = 0;
+    bool fromMaster = false;    // replica only: connection comes from our master
+    uint64_t id = 0;            // unique for the process lifetime, unlike fd
+    EventLoop* loop = nullptr;  // owning loop
+    bool blocked = false;       // parked by a blocking command; input waits in readBuffer
+    uint64_t blockTimer = 0;    // timeout of the blocking command, 0 if none
+
+    explicit Connection(int fd) : fd(fd) {}
+};
+
+// Edge-triggered epoll reactor. One thread calls run() and owns every socket registered with it,
+// so connections need no locking of their own.
+class EventLoop {
+public:
+    using ConnectionCallback = std::function<void(Connection&)>;
+    using TimerId = uint64_t;
+
+    // onData is called after each read cycle with everything received so far in readBuffer.
+    // onAccept (optional) is called once per new connection before any data is read.
+    // onClose (optional) is called just before a connection is closed and destroyed.
+    explicit EventLoop(ConnectionCallback onData, ConnectionCallback onAccept = nullptr,
+                       ConnectionCallback onClose = nullptr);
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // register a listening socket; it is switched to non-blocking
+    bool addListener(int listenFd);
+
+    // Timers run inside run(), between event batches, on the loop's thread. A periodic timer
+    // that falls behind skips ticks rather than queueing them. Loop thread only.
+    TimerId runEvery(std::chrono::milliseconds interval, std::function<void()> fn);
+    TimerId runAfter(std::chrono::milliseconds delay, std::function<void()> fn);
+    void cancelTimer(TimerId id);
+
+    // Run fn on the loop's thread soon. Safe to call from any thread.
+    void post(std::function<void()> fn);
+
+    // Loop thread only: the live connection on fd with the given id, or nullptr
+    // if it has been closed (its fd may since have been reused).
+    Connection* findConnection(int fd, uint64_t id);
+    // Loop thread only: run input that queued up while conn was blocked, then flush.
+    void resumeConnection(Connection& conn);
+    // Loop thread only: append bytes to conn's pending output and send what the socket takes.
+    void queueWrite(Connection& conn, std::string_view bytes);
+
+    // blocks until stop() is called
+    void run();
+
+    // safe to call from any thread
+    void stop();
+
+    size_t connectionCount() const { return connections_.size(); }
+
+private:
+    int epollFd_;
+    int wakeFd_;                    // eventfd used by stop() to interrupt epoll_wait
+    std::list<int> listenFds_;      // epoll data.ptr points at the element
+    std::atomic<bool> stopped_;
+    ConnectionCallback onData_;
+    ConnectionCallback onAccept_;
+    ConnectionCallback onClose_;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections_;
+    std::vector<std::unique_ptr<Connection>> closed_;  // destroyed after each event batch
+
+    using Clock = std::chrono::steady_clock;
+    struct Timer {
+        std::function<void()> fn;
+        std::chrono::milliseconds interval;  // zero for one-shot timers
+    };
+    using TimerEntry = std::pair<Clock::time_point, TimerId>;  // cancelled ids are skipped when due
+    std::priority_queue<TimerEntry, std::vector<TimerEntry>, std::greater<TimerEntry>> timerQueue_;
+    std::unordered_map<TimerId, Timer> timers_;
+    TimerId nextTimerId_ = 1;
+
+    std::mutex postMutex_;
+    std::vector<std::function<void()>> posted_;
+
+    TimerId addTimer(std::chrono::milliseconds delay, std::chrono::milliseconds interval, std::function<void()> fn);
+    // run due timers; returns the epoll_wait timeout until the next one, -1 if none
+    int runTimers();
+    void runPosted();
+    void acceptConnections(int listenFd);
+    void handleEvent(Connection& conn, uint32_t events);
+    bool readAvailable(Connection& conn);   // false on read error
+    bool flushWrites(Connection& conn);     // false on write error
+    // unregisters and closes conn's socket; conn itself is freed once the batch is over
+    void closeConnection(Connection& conn);
+};
+
+// Pin the calling thread to one CPU core. Returns false if the kernel refuses.
+bool pinThreadToCore(int core);
+
+#endif // EVENT_LOOP_HPP
@@ -0,0 +1,164 @@
+#include "HashValue.hpp"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+void HashValue::setCompactLimits(size_t maxEntries, size_t maxValue) {
+    maxCompactEntries_ = maxEntries;
+    maxCompactValue_ = maxValue;
+}
+
+HashValue::HashValue(HashValue&& other) noexcept
+    : data_(other.data_), used_(other.used_), capacity_(other.capacity_), count_(other.count_),
+      table_(std::move(other.table_)) {
+    other.data_ = nullptr;
+    other.used_ = other.capacity_ = other.count_ = 0;
+}
+
+HashValue& HashValue::operator=(HashValue&& other) noexcept {
+    HashValue taken(std::move(other));  // our old contents leave with it
+    std::swap(data_, taken.data_);
+    std::swap(used_, taken.used_);
+    std::swap(capacity_, taken.capacity_);
+    std::swap(count_, taken.count_);
+    std::swap(table_, taken.table_);
+    return *this;
+}
+
+HashValue::~HashValue() {
+    freeCompact();
+}
+
+void HashValue::writeEntry(char* pos, std::string_view text) {
+    uint32_t length = static_cast<uint32_t>(text.size());
+    if (length < LONG_LENGTH) {
+        *pos++ = static_cast<char>(length);
+    } else {
+        *pos++ = static_cast<char>(LONG_LENGTH);
+        std::memcpy(pos, &length, sizeof(length));
+        pos += sizeof(length);
+    }
+    std::memcpy(pos, text.data(), length);
+}
+
+std::string_view HashValue::readEntry(const char* pos) {
+    uint8_t first = static_cast<uint8_t>(*pos);
+    if (first != LONG_LENGTH) return {pos + 1, first};
+    uint32_t length;
+    std::memcpy(&length, pos + 1, sizeof(length));
+    return {pos + 1 + sizeof(length), length};
+}
+
+size_t HashValue::bytes() const {
+    if (!table_) return capacity_;
+    size_t buckets = table_->map.bucket_count() * sizeof(void*);
+    return sizeof(Table) + SlabAllocator::chunkSize(buckets) + table_->entryBytes;
+}
+
+uint32_t HashValue::locate(std::string_view field) const {
+    for (const char* pos = data_; pos < data_ + used_;) {
+        std::string_view current = readEntry(pos);
+        std::string_view value = readEntry(current.data() + current.size());
+        if (current == field) return static_cast<uint32_t>(pos - data_);
+        pos = value.data() + value.size();
+    }
+    return used_;
+}
+
+std::optional<std::string_view> HashValue::get(std::string_view field) const {
+    if (table_) {
+        auto it = table_->map.find(field);
+        if (it == table_->map.end()) return std::nullopt;
+        return std::string_view(it->second);
+    }
+    uint32_t offset = locate(field);
+    if (offset == used_) return std::nullopt;
+    return readEntry(data_ + offset + entrySize(field.size()));
+}
+
+bool HashValue::set(std::string_view field, std::string_view value) {
+    if (!table_) {
+        bool fits = field.size() <= maxCompactValue_ && value.size() <= maxCompactValue_;
+        uint32_t offset = fits ? locate(field) : used_;
+        if (fits && offset == used_ && count_ < maxCompactEntries_) {
+            size_t fieldBytes = entrySize(field.size());
+            size_t needed = fieldBytes + entrySize(value.size());
+            reserve(used_ + needed);
+            writeEntry(data_ + used_, field);
+            writeEntry(data_ + used_ + fieldBytes, value);
+            used_ += static_cast<uint32_t>(needed);
+            count_++;
+            return true;
+        }
+        if (fits && offset < used_) {
+            // replace the value where it is, shifting the pairs behind it
+            size_t at = offset + entrySize(field.size());
+            size_t oldBytes = entrySize(readEntry(data_ + at).size());
+            size_t newBytes = entrySize(value.size());
+            if (newBytes > oldBytes) reserve(used_ + newBytes - oldBytes);
+            std::memmove(data_ + at + newBytes, data_ + at + oldBytes, used_ - at - oldBytes);
+            writeEntry(data_ + at, value);
+            used_ = static_cast<uint32_t>(used_ + newBytes - oldBytes);
+            return false;
+        }
+        convertToTable();
+    }
+
+    Table& table = *table_;
+    auto it = table.map.find(field);
+    if (it != table.map.end()) {
+        table.entryBytes -= stringHeapBytes(it->second);
+        it->second.assign(value);
+        table.entryBytes += stringHeapBytes(it->second);
+        return false;
+    }
+    it = table.map.emplace(SlabString(field), SlabString(value)).first;
+    table.entryBytes += tableEntryBytes(it->first, it->second);
+    return true;
+}
+
+bool HashValue::erase(std::string_view field) {
+    if (table_) {
+        Table& table = *table_;
+        auto it = table.map.find(field);
+        if (it == table.map.end()) return false;
+        table.entryBytes -= tableEntryBytes(it->first, it->second);
+        table.map.erase(it);
+        return true;
+    }
+    uint32_t offset = locate(field);
+    if (offset == used_) return false;
+    size_t fieldBytes = entrySize(field.size());
+    size_t pairBytes = fieldBytes + entrySize(readEntry(data_ + offset + fieldBytes).size());
+    std::memmove(data_ + offset, data_ + offset + pairBytes, used_ - offset - pairBytes);
+    used_ -= static_cast<uint32_t>(pairBytes);
+    count_--;
+    return true;
+}
+
+void HashValue::reserve(size_t needed) {
+    if (needed <= capacity_) return;
+    size_t capacity = SlabAllocator::chunkSize(std::max<size_t>({needed, 2 * static_cast<size_t>(capacity_), 64}));
+    char* data = static_cast<char*>(SlabAllocator::allocate(capacity));
+    if (used_) std::memcpy(data, data_, used_);
+    SlabAllocator::deallocate(data_, capacity_);
+    data_ = data;
+    capacity_ = static_cast<uint32_t>(capacity);
+}
+
+void HashValue::convertToTable() {
+    auto table = std::make_unique<Table>();
+    table->map.reserve(count_ + 1);
+    forEach([&table](std::string_view field, std::string_view value) {
+        auto it = table->map.emplace(SlabString(field), SlabString(value)).first;
+        table->entryBytes += tableEntryBytes(it->first, it->second);
+    });
+    freeCompact();
+    table_ = std::move(table);
+}
+
+void HashValue::freeCompact() {
+    SlabAllocator::deallocate(data_, capacity_);
+    data_ = nullptr;
+    used_ = capacity_ = count_ = 0;
+}
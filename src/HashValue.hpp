@@ -0,0 +1,113 @@
+#ifndef HASH_VALUE_HPP
+#define HASH_VALUE_HPP
+
+#include <string>
+#include <string_view>
+#include <optional>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include "SlabAllocator.hpp"
+
+// Hash value (field -> value), stored in one of two encodings:
+//   Compact - fields and values packed back to back in one buffer, each length-prefixed,
+//             in insertion order; lookups scan it. Small hashes cost a single allocation
+//             and a few bytes per field instead of a node per field.
+//   Table   - a hash map, once the hash outgrows the compact limits (more than maxEntries
+//             fields, or a field or value longer than maxValue bytes). Never converts back.
+// Like Redis's hash-max-listpack-entries / hash-max-listpack-value, the limits are set
+// from the command line. Not thread-safe: the owning shard's lock covers it.
+class HashValue {
+public:
+    static constexpr size_t DEFAULT_MAX_COMPACT_ENTRIES = 128;
+    static constexpr size_t DEFAULT_MAX_COMPACT_VALUE = 64;
+
+    // Set while parsing the command line, before any hash is created.
+    static void setCompactLimits(size_t maxEntries, size_t maxValue);
+
+    HashValue() = default;
+    HashValue(HashValue&& other) noexcept;
+    HashValue& operator=(HashValue&& other) noexcept;
+    ~HashValue();
+
+    HashValue(const HashValue&) = delete;
+    HashValue& operator=(const HashValue&) = delete;
+
+    bool isCompact() const { return !table_; }
+    size_t size() const { return table_ ? table_->map.size() : count_; }
+    bool empty() const { return size() == 0; }
+    // heap bytes held: the compact buffer, or the map's nodes, strings and buckets
+    size_t bytes() const;
+
+    // value of field; the view is good until the hash is next modified
+    std::optional<std::string_view> get(std::string_view field) const;
+    // true if field is new, false if an existing value was replaced
+    bool set(std::string_view field, std::string_view value);
+    // false if field was absent
+    bool erase(std::string_view field);
+
+    // Call fn(std::string_view field, std::string_view value) for every field.
+    // Compact hashes go in insertion order, tables in no particular order.
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        if (table_) {
+            for (const auto& [field, value] : table_->map) fn(std::string_view(field), std::string_view(value));
+            return;
+        }
+        for (const char* pos = data_; pos < data_ + used_;) {
+            std::string_view field = readEntry(pos);
+            pos = field.data() + field.size();
+            std::string_view value = readEntry(pos);
+            pos = value.data() + value.size();
+            fn(field, value);
+        }
+    }
+
+private:
+    struct FieldHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view field) const { return std::hash<std::string_view>{}(field); }
+    };
+    using Map = std::unordered_map<SlabString, SlabString, FieldHash, std::equal_to<>,
+                                   SlabStlAllocator<std::pair<const SlabString, SlabString>>>;
+    struct Table {
+        Map map;
+        size_t entryBytes = 0;  // node and string bytes of the entries
+    };
+    // what a map node costs besides its strings' heap data: next pointer, cached hash, pair
+    static constexpr size_t TABLE_NODE_BYTES = sizeof(void*) + sizeof(size_t) + sizeof(Map::value_type);
+
+    static inline size_t maxCompactEntries_ = DEFAULT_MAX_COMPACT_ENTRIES;
+    static inline size_t maxCompactValue_ = DEFAULT_MAX_COMPACT_VALUE;
+
+    // compact encoding: data_[0, used_) holds count_ field/value pairs
+    char* data_ = nullptr;
+    uint32_t used_ = 0;
+    uint32_t capacity_ = 0;
+    uint32_t count_ = 0;
+    // table encoding; null while compact
+    std::unique_ptr<Table> table_;
+
+    // lengths under 128 take a one-byte prefix, longer ones five
+    static constexpr uint8_t LONG_LENGTH = 0x80;
+
+    static size_t headerSize(size_t length) { return length < LONG_LENGTH ? 1 : 5; }
+    static size_t entrySize(size_t length) { return headerSize(length) + length; }
+    static void writeEntry(char* pos, std::string_view text);
+    static std::string_view readEntry(const char* pos);
+
+    static size_t tableEntryBytes(const SlabString& field, const SlabString& value) {
+        return SlabAllocator::chunkSize(TABLE_NODE_BYTES) + stringHeapBytes(field) + stringHeapBytes(value);
+    }
+
+    // offset of field's pair in data_, or used_ if absent
+    uint32_t locate(std::string_view field) const;
+    // make room for at least `needed` bytes in data_
+    void reserve(size_t needed);
+    void convertToTable();
+    void freeCompact();
+};
+
+#endif // HASH_VALUE_HPP
@@ -0,0 +1,254 @@
+#include "KeyTable.hpp"
+#include "EpochManager.hpp"
+#include <new>
+
+// TSan can't see that the racy group loads are benign; sanitizer builds probe byte by byte
+#if defined(__SSE2__) && !defined(__SANITIZE_THREAD__)
+#define KEY_TABLE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+KeyTable::Slots::Slots(size_t cap)
+    : capacity(cap),
+      ctrl(static_cast<std::atomic<uint8_t>*>(::operator new[](cap, std::align_val_t(GROUP_SIZE)))),
+      slot(new std::atomic<KeyNode*>[cap]()) {
+    // groups are read with aligned 16-byte loads, hence the aligned raw allocation
+    for (size_t i = 0; i < cap; i++) {
+        new (&ctrl[i]) std::atomic<uint8_t>(CTRL_EMPTY);
+    }
+}
+
+KeyTable::Slots::~Slots() {
+    ::operator delete[](ctrl, std::align_val_t(GROUP_SIZE));
+    delete[] slot;
+}
+
+// Group loads race benignly with a writer's byte stores: a stale byte at worst sends the
+// reader to a slot whose pointer it then checks, or past a key inserted after it started.
+uint32_t KeyTable::matchByte(const std::atomic<uint8_t>* group, uint8_t value) {
+#ifdef KEY_TABLE_SSE2
+    __m128i ctrl = _mm_load_si128(reinterpret_cast<const __m128i*>(group));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(static_cast<char>(value)))));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < GROUP_SIZE; i++) {
+        if (group[i].load(std::memory_order_relaxed) == value) mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+uint32_t KeyTable::matchFree(const std::atomic<uint8_t>* group) {
+#ifdef KEY_TABLE_SSE2
+    // EMPTY and DELETED are the only bytes with the top bit set
+    __m128i ctrl = _mm_load_si128(reinterpret_cast<const __m128i*>(group));
+    return static_cast<uint32_t>(_mm_movemask_epi8(ctrl));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < GROUP_SIZE; i++) {
+        if (group[i].load(std::memory_order_relaxed) & CTRL_FREE_BIT) mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+size_t KeyNode::memoryUsage() const {
+    size_t bytes = SlabAllocator::chunkSize(sizeof(KeyNode)) + stringHeapBytes(key);
+    if (const auto* str = std::get_if<StringValue>(&entry.value)) bytes += str->heapBytes();
+    else if (const auto* list = std::get_if<QuickList>(&entry.value)) bytes += list->bytes();
+    else if (const auto* fields = std::get_if<HashValue>(&entry.value)) bytes += fields->bytes();
+    else if (const auto* zset = std::get_if<SortedSet>(&entry.value)) bytes += zset->bytes();
+    return bytes;
+}
+
+KeyTable::KeyTable() : slots_(new Slots(INITIAL_CAPACITY)), tableBytes_(Slots::bytesFor(INITIAL_CAPACITY)) {}
+
+KeyTable::~KeyTable() {
+    Slots* slots = slots_.load(std::memory_order_relaxed);
+    while (slots) {
+        for (size_t i = 0; i < slots->capacity; i++) {
+            if (slots->ctrl[i].load(std::memory_order_relaxed) & CTRL_FREE_BIT) continue;
+            delete slots->slot[i].load(std::memory_order_relaxed);
+        }
+        Slots* next = slots->next.load(std::memory_order_relaxed);
+        delete slots;
+        slots = next;
+    }
+}
+
+KeyNode* KeyTable::find(std::string_view key, uint64_t hash) const {
+    // a node being moved lands in the new array before it leaves the old one, so
+    // checking the old array first and then following next can't miss it
+    for (const Slots* slots = slots_.load(std::memory_order_acquire); slots;
+         slots = slots->next.load(std::memory_order_acquire)) {
+        size_t groupMask = slots->capacity / GROUP_SIZE - 1;
+        uint8_t tag = h2(hash);
+
+        // triangular steps over groups visit every group of a power-of-two table
+        size_t group = firstGroup(hash, groupMask);
+        for (size_t step = 1;; step++) {
+            const std::atomic<uint8_t>* ctrl = slots->ctrl + group * GROUP_SIZE;
+            uint32_t candidates = matchByte(ctrl, tag);
+            std::atomic_thread_fence(std::memory_order_acquire);  // pairs with the writer's ctrl release
+            while (candidates) {
+                size_t i = group * GROUP_SIZE + __builtin_ctz(candidates);
+                candidates &= candidates - 1;
+                KeyNode* node = slots->slot[i].load(std::memory_order_acquire);
+                if (node && node->hash == hash && node->key == key) return node;
+            }
+            if (matchEmpty(ctrl)) break;  // key would have been placed here
+            group = (group + step) & groupMask;
+        }
+    }
+    return nullptr;
+}
+
+void KeyTable::prefetch(uint64_t hash) const {
+    for (const Slots* slots = slots_.load(std::memory_order_acquire); slots;
+         slots = slots->next.load(std::memory_order_acquire)) {
+        size_t first = firstGroup(hash, slots->capacity / GROUP_SIZE - 1) * GROUP_SIZE;
+        __builtin_prefetch(slots->ctrl + first);
+        // a group's 16 pointers span two cache lines
+        __builtin_prefetch(slots->slot + first);
+        __builtin_prefetch(slots->slot + first + GROUP_SIZE / 2);
+    }
+}
+
+size_t KeyTable::locate(const Slots* slots, std::string_view key, uint64_t hash) {
+    size_t groupMask = slots->capacity / GROUP_SIZE - 1;
+    uint8_t tag = h2(hash);
+
+    size_t group = firstGroup(hash, groupMask);
+    for (size_t step = 1;; step++) {
+        const std::atomic<uint8_t>* ctrl = slots->ctrl + group * GROUP_SIZE;
+        uint32_t candidates = matchByte(ctrl, tag);
+        while (candidates) {
+            size_t i = group * GROUP_SIZE + __builtin_ctz(candidates);
+            candidates &= candidates - 1;
+            KeyNode* node = slots->slot[i].load(std::memory_order_relaxed);
+            if (node->hash == hash && node->key == key) return i;
+        }
+        if (matchEmpty(ctrl)) return SIZE_MAX;
+        group = (group + step) & groupMask;
+    }
+}
+
+void KeyTable::place(Slots* slots, KeyNode* node) {
+    size_t groupMask = slots->capacity / GROUP_SIZE - 1;
+
+    size_t group = firstGroup(node->hash, groupMask);
+    for (size_t step = 1;; step++) {
+        uint32_t free = matchFree(slots->ctrl + group * GROUP_SIZE);
+        if (free) {
+            size_t i = group * GROUP_SIZE + __builtin_ctz(free);
+            if (slots->ctrl[i].load(std::memory_order_relaxed) == CTRL_EMPTY) slots->used++;
+            slots->slot[i].store(node, std::memory_order_release);
+            slots->ctrl[i].store(h2(node->hash), std::memory_order_release);  // pointer first, then make it findable
+            return;
+        }
+        group = (group + step) & groupMask;
+    }
+}
+
+void KeyTable::clearSlot(Slots* slots, size_t i) {
+    slots->ctrl[i].store(CTRL_DELETED, std::memory_order_release);
+    slots->slot[i].store(nullptr, std::memory_order_release);
+}
+
+void KeyTable::insert(KeyNode* node) {
+    rehashStep(REHASH_STEP);
+
+    // replace in whichever array holds the key; the old one can't be dropped until it is empty
+    for (Slots* slots = slots_.load(std::memory_order_relaxed); slots;
+         slots = slots->next.load(std::memory_order_relaxed)) {
+        size_t i = locate(slots, node->key, node->hash);
+        if (i == SIZE_MAX) continue;
+        KeyNode* current = slots->slot[i].load(std::memory_order_relaxed);
+        slots->slot[i].store(node, std::memory_order_release);
+        addBytes(nodeBytes_, static_cast<ptrdiff_t>(node->memoryUsage()) - static_cast<ptrdiff_t>(current->memoryUsage()));
+        EpochManager::getInstance().retire(current);
+        return;
+    }
+
+    Slots* oldSlots = slots_.load(std::memory_order_relaxed);
+    Slots* target = oldSlots->next.load(std::memory_order_relaxed);
+    if (!target) target = oldSlots;
+    place(target, node);
+    live_++;
+    addBytes(nodeBytes_, static_cast<ptrdiff_t>(node->memoryUsage()));
+
+    // A rehash target can't fill up: each write advances the move by REHASH_STEP old slots or more, so
+    // at most capacity/REHASH_STEP writes land in it before the old array drains.
+    if (target != oldSlots || target->used * 8 <= target->capacity * 7) return;
+    // double only when live nodes need it; a table clogged with DELETED slots is just compacted
+    size_t capacity = target->capacity;
+    if (live_ * 2 > capacity) capacity *= 2;
+    startRehash(capacity);
+}
+
+bool KeyTable::erase(std::string_view key, uint64_t hash) {
+    rehashStep(REHASH_STEP);
+
+    for (Slots* slots = slots_.load(std::memory_order_relaxed); slots;
+         slots = slots->next.load(std::memory_order_relaxed)) {
+        size_t i = locate(slots, key, hash);
+        if (i == SIZE_MAX) continue;
+        KeyNode* node = slots->slot[i].load(std::memory_order_relaxed);
+        clearSlot(slots, i);
+        live_--;
+        addBytes(nodeBytes_, -static_cast<ptrdiff_t>(node->memoryUsage()));
+        EpochManager::getInstance().retire(node);
+        return true;
+    }
+    return false;
+}
+
+void KeyTable::startRehash(size_t capacity) {
+    Slots* oldSlots = slots_.load(std::memory_order_relaxed);
+    // published before the first move, so a reader that misses in the old array sees it
+    oldSlots->next.store(new Slots(capacity), std::memory_order_release);
+    addBytes(tableBytes_, static_cast<ptrdiff_t>(Slots::bytesFor(capacity)));
+    rehashIndex_ = 0;
+}
+
+bool KeyTable::rehashStep(size_t nodes) {
+    Slots* oldSlots = slots_.load(std::memory_order_relaxed);
+    Slots* newSlots = oldSlots->next.load(std::memory_order_relaxed);
+    if (!newSlots) return false;
+
+    // bound the free slots skipped too, so one step over a sparse stretch stays short
+    size_t emptyVisits = nodes * REHASH_EMPTY_VISITS;
+    while (nodes > 0 && rehashIndex_ < oldSlots->capacity) {
+        size_t i = rehashIndex_++;
+        if (oldSlots->ctrl[i].load(std::memory_order_relaxed) & CTRL_FREE_BIT) {
+            if (--emptyVisits == 0) break;
+            continue;
+        }
+        KeyNode* node = oldSlots->slot[i].load(std::memory_order_relaxed);
+        place(newSlots, node);  // findable in the new array before it leaves the old one
+        clearSlot(oldSlots, i);
+        nodes--;
+    }
+
+    if (rehashIndex_ < oldSlots->capacity) return true;
+    finishRehash();
+    return false;
+}
+
+void KeyTable::finishRehash() {
+    Slots* oldSlots = slots_.load(std::memory_order_relaxed);
+    Slots* newSlots = oldSlots->next.load(std::memory_order_relaxed);
+    for (size_t i = rehashIndex_; i < oldSlots->capacity; i++) {
+        if (oldSlots->ctrl[i].load(std::memory_order_relaxed) & CTRL_FREE_BIT) continue;
+        KeyNode* node = oldSlots->slot[i].load(std::memory_order_relaxed);
+        place(newSlots, node);
+        clearSlot(oldSlots, i);
+    }
+    rehashIndex_ = 0;
+
+    // readers still probing the old arrays keep them alive until their guards end;
+    // its next pointer stays set so they still reach the new one
+    slots_.store(newSlots, std::memory_order_release);
+    addBytes(tableBytes_, -static_cast<ptrdiff_t>(Slots::bytesFor(oldSlots->capacity)));
+    EpochManager::getInstance().retire(oldSlots);
+}
@@ -0,0 +1,185 @@
+#ifndef KEY_TABLE_HPP
+#define KEY_TABLE_HPP
+
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include "StringValue.hpp"
+#include "QuickList.hpp"
+#include "HashValue.hpp"
+#include "SortedSet.hpp"
+#include "SlabAllocator.hpp"
+
+struct KeyHash {
+    size_t operator()(std::string_view key) const { return std::hash<std::string_view>{}(key); }
+};
+
+// One key's value. The variant index is the type tag (strings carry their own encoding);
+// the TTL lives inline so checking expiry costs no extra lookup.
+struct Entry {
+    static constexpr long long NO_EXPIRY = -1;
+
+    std::variant<StringValue, QuickList, HashValue, SortedSet> value;
+    long long expireAt = NO_EXPIRY;  // unix time in ms
+
+    bool expiredAt(long long nowMs) const { return expireAt != NO_EXPIRY && nowMs > expireAt; }
+    bool isString() const { return std::holds_alternative<StringValue>(value); }
+    bool isList() const { return std::holds_alternative<QuickList>(value); }
+    bool isHash() const { return std::holds_alternative<HashValue>(value); }
+    bool isSortedSet() const { return std::holds_alternative<SortedSet>(value); }
+};
+
+// A key and its value as published in a KeyTable. Once published, a string value never
+// changes: writers build a new node and swap it in. Lists, hashes and sorted sets are the
+// exception and are only mutated in place under the owning shard's exclusive lock. access is the eviction
+// clock (LRU time or LFU counter, see DB), bumped by readers too, hence atomic.
+// Nodes and their keys live in the slab allocator.
+struct KeyNode {
+    uint64_t hash;
+    SlabString key;
+    Entry entry;
+    mutable std::atomic<uint32_t> access{0};
+
+    // bytes this node holds: itself, a key too long for SSO, and the value's heap data
+    size_t memoryUsage() const;
+
+    static void* operator new(size_t size) { return SlabAllocator::allocate(size); }
+    static void operator delete(void* ptr, size_t size) { SlabAllocator::deallocate(ptr, size); }
+};
+
+// Swiss-table style map of KeyNode pointers with one writer at a time and lock-free
+// readers. Alongside the pointer array sits one control byte per slot: EMPTY, DELETED or
+// the low 7 bits of the key's hash. Lookups test a whole 16-slot group of control bytes at
+// once (SSE2) and only dereference nodes whose byte matches, so a miss rarely touches a
+// node at all. Writers publish a slot's pointer before its control byte. Deleted slots keep
+// a DELETED byte so probes continue past them. Replaced and erased nodes, and outgrown
+// arrays, are retired through EpochManager, so lock-free readers must hold an EpochGuard.
+//
+// Growing is incremental, like Redis's dict: a full table links a bigger one as its next
+// array, new keys go there, and every write (plus rehashStep() from the server's idle
+// tick) moves a few nodes across. Until the move completes readers fall through from the
+// old array to the new one on a miss, so no single write pays for copying the whole table.
+class KeyTable {
+public:
+    KeyTable();
+    ~KeyTable();  // frees everything directly: no reader may remain
+
+    KeyTable(const KeyTable&) = delete;
+    KeyTable& operator=(const KeyTable&) = delete;
+
+    // Reader side, no lock needed (hold an EpochGuard). nullptr if absent.
+    KeyNode* find(std::string_view key, uint64_t hash) const;
+    // Start loading the control bytes and slots where hash's probe begins, in each array.
+    // Only a hint: batches call it a few keys ahead so the misses overlap.
+    void prefetch(uint64_t hash) const;
+
+    // Writer side: callers serialize these (the shard's exclusive lock).
+    // Publish node, replacing and retiring any node with the same key. Takes ownership.
+    void insert(KeyNode* node);
+    // Unlink and retire key's node; false if absent.
+    bool erase(std::string_view key, uint64_t hash);
+
+    // Writer side: move up to `nodes` nodes into the new array. False once no rehash is
+    // in progress, so callers can stop ticking.
+    bool rehashStep(size_t nodes);
+    bool rehashing() const { return slots_.load(std::memory_order_relaxed)->next.load(std::memory_order_relaxed); }
+
+    size_t size() const { return live_; }
+    // bytes held by the table itself (slot and control arrays, both while rehashing) and by
+    // its nodes. Kept up to date by the writer, so readable without the lock.
+    size_t tableBytes() const { return tableBytes_.load(std::memory_order_relaxed); }
+    size_t nodeBytes() const { return nodeBytes_.load(std::memory_order_relaxed); }
+    // Writer side: a node's value grew or shrank in place (lists) by delta bytes.
+    void nodeResized(ptrdiff_t delta) { addBytes(nodeBytes_, delta); }
+
+    // Visit every node. Caller excludes writers (shard lock, shared is enough).
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        for (const Slots* slots = slots_.load(std::memory_order_acquire); slots;
+             slots = slots->next.load(std::memory_order_acquire)) {
+            for (size_t i = 0; i < slots->capacity; i++) {
+                if (slots->ctrl[i].load(std::memory_order_relaxed) & CTRL_FREE_BIT) continue;
+                KeyNode* node = slots->slot[i].load(std::memory_order_relaxed);
+                if (node) fn(*node);
+            }
+        }
+    }
+
+    // Call fn(const KeyNode&) for up to count nodes taken from a random position onward,
+    // visiting at most count * SAMPLE_VISITS slots per array. Caller excludes writers.
+    template <typename Fn>
+    void sample(uint64_t seed, size_t count, Fn&& fn) const {
+        for (const Slots* slots = slots_.load(std::memory_order_acquire); slots && count > 0;
+             slots = slots->next.load(std::memory_order_acquire)) {
+            size_t mask = slots->capacity - 1;
+            size_t visits = std::min(count * SAMPLE_VISITS, slots->capacity);
+            for (size_t i = seed & mask; visits > 0 && count > 0; i = (i + 1) & mask, visits--) {
+                if (slots->ctrl[i].load(std::memory_order_relaxed) & CTRL_FREE_BIT) continue;
+                KeyNode* node = slots->slot[i].load(std::memory_order_relaxed);
+                if (!node) continue;
+                fn(*node);
+                count--;
+            }
+        }
+    }
+
+private:
+    static constexpr size_t GROUP_SIZE = 16;           // control bytes per SIMD probe
+    static constexpr size_t INITIAL_CAPACITY = 16;
+    static constexpr uint8_t CTRL_EMPTY = 0x80;
+    static constexpr uint8_t CTRL_DELETED = 0xFE;
+    static constexpr uint8_t CTRL_FREE_BIT = 0x80;     // set for EMPTY and DELETED, clear for full
+    static constexpr size_t REHASH_STEP = 4;           // nodes moved per write while rehashing
+    static constexpr size_t REHASH_EMPTY_VISITS = 10;  // free slots skipped per node moved, at most
+    static constexpr size_t SAMPLE_VISITS = 10;        // slots visited per node sampled, at most
+
+    struct Slots {
+        size_t capacity;  // power of two, multiple of GROUP_SIZE
+        std::atomic<uint8_t>* ctrl;
+        std::atomic<KeyNode*>* slot;
+        size_t used = 0;  // full + deleted; kept under 7/8 of capacity so every probe ends
+        std::atomic<Slots*> next{nullptr};  // rehash target, set before any node moves
+
+        explicit Slots(size_t cap);
+        ~Slots();
+
+        static size_t bytesFor(size_t cap) { return sizeof(Slots) + cap * (sizeof(uint8_t) + sizeof(KeyNode*)); }
+    };
+
+    std::atomic<Slots*> slots_;  // oldest array; readers start here
+    size_t live_ = 0;            // full slots across both arrays
+    size_t rehashIndex_ = 0;     // old-array slots below this have been moved
+    std::atomic<size_t> tableBytes_{0};
+    std::atomic<size_t> nodeBytes_{0};
+
+    // single writer, so a plain load and store will do
+    static void addBytes(std::atomic<size_t>& counter, ptrdiff_t delta) {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    static uint8_t h2(uint64_t hash) { return hash & 0x7F; }
+    static size_t firstGroup(uint64_t hash, size_t groupMask) { return (hash >> 7) & groupMask; }
+
+    // bitmasks over one group: bit i set where byte i == value / is EMPTY / is EMPTY or DELETED
+    static uint32_t matchByte(const std::atomic<uint8_t>* group, uint8_t value);
+    static uint32_t matchEmpty(const std::atomic<uint8_t>* group) { return matchByte(group, CTRL_EMPTY); }
+    static uint32_t matchFree(const std::atomic<uint8_t>* group);
+
+    // slot index holding key in slots, or SIZE_MAX
+    static size_t locate(const Slots* slots, std::string_view key, uint64_t hash);
+    // place a node known to be absent at the first free slot on its probe path
+    static void place(Slots* slots, KeyNode* node);
+    // mark the slot DELETED, leaving the node to the caller
+    static void clearSlot(Slots* slots, size_t i);
+
+    // link a fresh array of the given capacity as the rehash target; DELETED slots are
+    // dropped on the way, so an unchanged capacity just compacts
+    void startRehash(size_t capacity);
+    void finishRehash();
+};
+
+#endif // KEY_TABLE_HPP
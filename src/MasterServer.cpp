@@ -1,7 +1,12 @@
 #include "MasterServer.hpp"
+#include "command_table.hpp"
+#include "ServerClock.hpp"
+#include "EventLoop.hpp"
 #include <sstream>
 #include <fstream>
 #include <algorithm>
+#include <charconv>
+#include <chrono>
 
 MasterServer::MasterServer(int port) 
     : masterPort(port), db(DB::getInstance()), replicationOffset(0) {
@@ -11,7 +16,7 @@ MasterServer::MasterServer(int port)
 
 MasterServer::~MasterServer() {
     for (auto& replica : replicas) {
-        if (replica.socket >= 0) {
+        if (replica.socket >= 0 && !replica.loop) {  // a loop closes its own sockets
             close(replica.socket);
             replica.socket = -1;
         }
@@ -32,10 +37,19 @@ std::string MasterServer::generateMasterRunId() {
     return id;
 }
 
-std::string MasterServer::formatRESP(const std::vector<std::string> &args) {
+namespace {
+    bool parseInteger(std::string_view text, long long& value) {
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        return ec == std::errc() && ptr == text.data() + text.size();
+    }
+}
+
+std::string MasterServer::formatRESP(const CommandArgs& args) {
     std::string resp = "*" + std::to_string(args.size()) + "\r\n";
     for (const auto &arg : args) {
-        resp += "$" + std::to_string(arg.length()) + "\r\n" + arg + "\r\n";
+        resp += "$" + std::to_string(arg.length()) + "\r\n";
+        resp.append(arg);
+        resp += "\r\n";
     }
     return resp;
 }
@@ -142,6 +156,7 @@ bool MasterServer::connectToReplica(ReplicaInfo& replica) {
     
     replica.connected = true;
     replica.offset = replicationOffset; 
+    replica.lastIoMs = ServerClock::monotonicMs();
     
     return true;
 }
@@ -163,6 +178,7 @@ void MasterServer::addReplica(const std::string& host, int port) {
     }
     
     replicas.emplace_back(host, port);
+    replicaCount.store(replicas.size(), std::memory_order_release);
     
     connectToReplica(replicas.back());
     
@@ -178,10 +194,11 @@ void MasterServer::removeReplica(const std::string& host, int port) {
     
     for (auto it = replicas.begin(); it != replicas.end(); ++it) {
         if (it->host == host && it->port == port) {
-            if (it->socket >= 0) {
+            if (it->socket >= 0 && !it->loop) {
                 close(it->socket);
             }
             replicas.erase(it);
+            replicaCount.store(replicas.size(), std::memory_order_release);
             std::cout << "Removed replica " << host << ":" << port << "\n";
             return;
         }
@@ -190,20 +207,39 @@ void MasterServer::removeReplica(const std::string& host, int port) {
     std::cerr << "Replica " << host << ":" << port << " not found in the list\n";
 }
 
-bool MasterServer::sendCommand(const std::vector<std::string> &cmdArgs) {
+bool MasterServer::sendCommand(const CommandArgs& cmdArgs) {
+    // every write on every io thread comes through here, so the common no-replica case
+    // must not touch the shared mutex
+    if (replicaCount.load(std::memory_order_acquire) == 0) {
+        return false;
+    }
+    std::string formattedCmd = formatRESP(cmdArgs);
+
     std::lock_guard<std::mutex> lock(mutex);
-    
     if (replicas.empty()) {
-        std::cerr << "No replicas configured. Command not sent.\n";
         return false;
     }
     
     bool allSucceeded = true;
-    std::string formattedCmd = formatRESP(cmdArgs);
-    
     replicationOffset += formattedCmd.size();
     
     for (auto& replica : replicas) {
+        if (replica.loop) {
+            // queue behind whatever the loop already holds for this replica (the sync
+            // payload included); tasks posted to a loop run in order, so writes stay in order
+            EventLoop* loop = replica.loop;
+            int fd = replica.socket;
+            uint64_t id = replica.connectionId;
+            loop->post([loop, fd, id, formattedCmd] {
+                if (Connection* conn = loop->findConnection(fd, id)) {
+                    loop->queueWrite(*conn, formattedCmd);
+                }
+            });
+            replica.offset += formattedCmd.size();
+            replica.lastIoMs = ServerClock::monotonicMs();
+            continue;
+        }
+
         if (!replica.connected || replica.socket < 0) {
             if (!connectToReplica(replica)) {
                 allSucceeded = false;
@@ -235,50 +271,44 @@ bool MasterServer::sendCommand(const std::vector<std::string> &cmdArgs) {
         
         if (sentBytes > 0) {
             replica.offset += sentBytes;
+            replica.lastIoMs = ServerClock::monotonicMs();
         }
     }
     
     return allSucceeded;
 }
 
-bool MasterServer::propagateWrite(const std::vector<std::string> &cmdArgs) {
+bool MasterServer::propagateWrite(const CommandArgs& cmdArgs) {
     return sendCommand(cmdArgs);
 }
 
-void MasterServer::handleReplicationCommand(int clientSocket, const std::vector<RESPElement>& args) {
+void MasterServer::handleReplicationCommand(Connection& conn, const CommandArgs& args, ReplyBuilder& reply) {
     if (args.empty()) {
-        std::string response = "-ERR invalid replication command\r\n";
-        send(clientSocket, response.c_str(), response.length(), 0);
+        reply.error("ERR invalid replication command");
         return;
     }
     
-    std::string command = args[0].value;
-    std::transform(command.begin(), command.end(), command.begin(), ::toupper);
+    std::string_view command = args[0];
     
-    if (command == "PSYNC") {
-        handlePSYNC(clientSocket, args);
+    if (equalsIgnoreCase(command, "PSYNC")) {
+        handlePSYNC(conn, args, reply);
     }
-    else if (command == "REPLCONF") {
+    else if (equalsIgnoreCase(command, "REPLCONF")) {
         if (args.size() >= 2) {
-            std::string subCommand = args[1].value;
-            std::transform(subCommand.begin(), subCommand.end(), subCommand.begin(), ::toupper);
-            
-            if (subCommand == "ACK" && args.size() >= 3) {
-                std::string response = "+OK\r\n";
-                send(clientSocket, response.c_str(), response.length(), 0);
+            if (equalsIgnoreCase(args[1], "ACK") && args.size() >= 3) {
+                reply.simpleString("OK");
             }
             else {
-                std::string response = "+OK\r\n";
-                send(clientSocket, response.c_str(), response.length(), 0);
+                reply.simpleString("OK");
             }
         }
         else {
-            std::string response = "-ERR wrong number of arguments for 'REPLCONF' command\r\n";
-            send(clientSocket, response.c_str(), response.length(), 0);
+            reply.error("ERR wrong number of arguments for 'REPLCONF' command");
         }
     }
-    else if (command == "INFO") {
-        // Generate INFO replication section
+    else if (equalsIgnoreCase(command, "INFO")) {
+        // Generate INFO replication section; replicas come and go from other loops' threads
+        std::unique_lock<std::mutex> lock(mutex);
         std::string info = "# Replication\r\n";
         info += "role:master\r\n";
         info += "master_replid:" + masterRunId + "\r\n";
@@ -293,90 +323,106 @@ void MasterServer::handleReplicationCommand(int clientSocket, const std::vector<
         
         // Add info for each connected replica
         int slaveIndex = 0;
+        long long now = ServerClock::monotonicMs();
         for (const auto& replica : replicas) {
             if (replica.connected) {
                 info += "slave" + std::to_string(slaveIndex) + ":ip=" + replica.host + 
                         ",port=" + std::to_string(replica.port) + 
                         ",state=online,offset=" + std::to_string(replica.offset) + 
-                        ",lag=0\r\n";
+                        ",lag=" + std::to_string((now - replica.lastIoMs) / 1000) + "\r\n";
                 slaveIndex++;
             }
         }
+        lock.unlock();
+        info += "\r\n" + DB::getInstance().infoStats();
+        info += "\r\n" + DB::getInstance().infoMemory();
         
         // Send the info as a RESP bulk string
-        std::string response = "$" + std::to_string(info.length()) + "\r\n" + info + "\r\n";
-        send(clientSocket, response.c_str(), response.length(), 0);
+        reply.bulkString(info);
     }
-    else if (command == "WAIT") {
+    else if (equalsIgnoreCase(command, "WAIT")) {
         if (args.size() >= 3) {
-            int numReplicas = std::stoi(args[1].value);
-            int timeout = std::stoi(args[2].value);
-            
-            // Get number of connected replicas that have caught up
-            int ackedReplicas = 0;
+            long long numReplicas = 0;
+            long long timeout = 0;
+            if (!parseInteger(args[1], numReplicas) || !parseInteger(args[2], timeout)) {
+                reply.error("ERR value is not an integer or out of range");
+                return;
+            }
+            if (timeout < 0) {
+                reply.error("ERR timeout is negative");
+                return;
+            }
+
+            long long target;
             {
                 std::lock_guard<std::mutex> lock(mutex);
-                for (const auto& replica : replicas) {
-                    if (replica.connected && replica.offset >= replicationOffset) {
-                        ackedReplicas++;
-                    }
-                }
+                target = replicationOffset;
             }
-            
-            // If we don't have enough replicas, wait up to timeout
-            if (ackedReplicas < numReplicas) {
-                usleep(std::min(timeout, 100) * 1000);
-                
-                // Recount after waiting
-                ackedReplicas = 0;
-                {
-                    std::lock_guard<std::mutex> lock(mutex);
-                    for (const auto& replica : replicas) {
-                        if (replica.connected && replica.offset >= replicationOffset) {
-                            ackedReplicas++;
-                        }
-                    }
-                }
+            int ackedReplicas = countReplicasAt(target);
+
+            // This runs on the reactor thread, so it must not sleep: the client is parked like
+            // BLPOP and gets a recount when the timeout runs out. Offsets advance when a write
+            // is sent, not on REPLCONF ACK, so nothing would wake a WAIT with timeout 0; it
+            // answers at once instead of blocking forever.
+            if (ackedReplicas < numReplicas && timeout > 0) {
+                EventLoop* loop = conn.loop;
+                int fd = conn.fd;
+                uint64_t id = conn.id;
+                timeout = std::min(timeout, 1000LL * 1000 * 1000 * 1000);  // keeps ms in range
+                conn.blocked = true;
+                conn.blockTimer = loop->runAfter(std::chrono::milliseconds(timeout),
+                    [this, loop, fd, id, target] {
+                        Connection* client = loop->findConnection(fd, id);
+                        if (!client) return;
+                        client->blocked = false;
+                        client->blockTimer = 0;
+                        ReplyBuilder(client->writeBuffer).integer(countReplicasAt(target));
+                        loop->resumeConnection(*client);
+                    });
+                return;  // the reply comes when the timer fires
             }
-            
-            std::string response = ":" + std::to_string(ackedReplicas) + "\r\n";
-            send(clientSocket, response.c_str(), response.length(), 0);
+
+            reply.integer(ackedReplicas);
         }
         else {
-            std::string response = "-ERR wrong number of arguments for 'WAIT' command\r\n";
-            send(clientSocket, response.c_str(), response.length(), 0);
+            reply.error("ERR wrong number of arguments for 'WAIT' command");
         }
     }
     else {
-        std::string response = "-ERR unknown replication command\r\n";
-        send(clientSocket, response.c_str(), response.length(), 0);
+        reply.error("ERR unknown replication command");
+    }
+}
+
+int MasterServer::countReplicasAt(long long offset) {
+    std::lock_guard<std::mutex> lock(mutex);
+    int count = 0;
+    for (const auto& replica : replicas) {
+        if (replica.connected && replica.offset >= offset) {
+            count++;
+        }
     }
+    return count;
 }
 
+// the keyspace in the dump format, which the replica loads through loadRDB
 std::string MasterServer::generateRDBSnapshot() {
-    std::string rdbData = "REDIS0009";  // Redis RDB version 9
-    
-    rdbData += "\xFF";
-    
-    return rdbData;
+    return db.snapshotRDB();
 }
 
-void MasterServer::handlePSYNC(int clientSocket, const std::vector<RESPElement>& args) {
+void MasterServer::handlePSYNC(Connection& conn, const CommandArgs& args, ReplyBuilder& reply) {
     if (args.size() < 3) {
-        std::string response = "-ERR wrong number of arguments for 'PSYNC' command\r\n";
-        send(clientSocket, response.c_str(), response.length(), 0);
+        reply.error("ERR wrong number of arguments for 'PSYNC' command");
         return;
     }
     
-    std::string requestedReplicationId = args[1].value;
-    std::string requestedOffsetStr = args[2].value;
+    std::string requestedReplicationId(args[1]);
+    std::string requestedOffsetStr(args[2]);
     long long requestedOffset = 0;
     
     try {
         requestedOffset = std::stoll(requestedOffsetStr);
     } catch (const std::exception& e) {
-        std::string response = "-ERR invalid PSYNC offset\r\n";
-        send(clientSocket, response.c_str(), response.length(), 0);
+        reply.error("ERR invalid PSYNC offset");
         return;
     }
     
@@ -386,140 +432,91 @@ void MasterServer::handlePSYNC(int clientSocket, const std::vector<RESPElement>&
     // If the replica is asking for initial sync (? as replication ID)
     // or if the replication ID doesn't match ours, do a full resync
     if (requestedReplicationId == "?" || requestedReplicationId != masterRunId) {
-        // Full resync
-        std::string fullResyncResponse = "+FULLRESYNC " + masterRunId + " " + std::to_string(replicationOffset) + "\r\n";
-        if (send(clientSocket, fullResyncResponse.c_str(), fullResyncResponse.length(), 0) < 0) {
-            std::cerr << "Error sending FULLRESYNC response\n";
-            return;
-        }
-        
-        std::cout << "Sending FULLRESYNC response: " << fullResyncResponse;
-        
-        // Generate RDB snapshot
-        std::string rdbSnapshot = generateRDBSnapshot();
-        
-        // Send RDB snapshot as a RESP bulk string
-        std::string rdbHeader = "$" + std::to_string(rdbSnapshot.size()) + "\r\n";
-        if (send(clientSocket, rdbHeader.c_str(), rdbHeader.length(), 0) < 0) {
-            std::cerr << "Error sending RDB header\n";
-            return;
-        }
-        
-        if (send(clientSocket, rdbSnapshot.c_str(), rdbSnapshot.size(), 0) < 0) {
-            std::cerr << "Error sending RDB data\n";
-            return;
-        }
-        
-        std::string crlf = "\r\n";
-        if (send(clientSocket, crlf.c_str(), crlf.length(), 0) < 0) {
-            std::cerr << "Error sending CRLF after RDB data\n";
-            return;
-        }
-        
-        std::cout << "Sent RDB snapshot, size: " << rdbSnapshot.size() << " bytes\n";
-        
-        struct sockaddr_in addr;
-        socklen_t addrLen = sizeof(addr);
-        getpeername(clientSocket, (struct sockaddr*)&addr, &addrLen);
-        
-        char ip[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &(addr.sin_addr), ip, INET_ADDRSTRLEN);
-        int port = ntohs(addr.sin_port);
-        
-        std::string host(ip);
-        
-        bool found = false;
-        {
-            std::lock_guard<std::mutex> lock(mutex);
-            for (auto& replica : replicas) {
-                if (replica.host == host && replica.port == port) {
-                    // Update existing replica
-                    replica.socket = clientSocket;
-                    replica.connected = true;
-                    replica.offset = replicationOffset;
-                    found = true;
-                    break;
-                }
-            }
-            
-            if (!found) {
-                // Add new replica
-                replicas.emplace_back(host, port);
-                replicas.back().socket = clientSocket;
-                replicas.back().connected = true;
-                replicas.back().offset = replicationOffset;
-                
-                std::cout << "Added new replica: " << host << ":" << port << "\n";
-            }
-        }
+        fullResync(conn, reply);
     }
     else if (requestedOffset <= replicationOffset) {
         // Partial resync
-        std::string continueResponse = "+CONTINUE " + masterRunId + "\r\n";
-        if (send(clientSocket, continueResponse.c_str(), continueResponse.length(), 0) < 0) {
-            std::cerr << "Error sending CONTINUE response\n";
-            return;
+        {
+            std::unique_lock<std::shared_mutex> gate(writeGate);
+            registerReplica(conn, requestedOffset);
         }
+        std::string continueResponse = "+CONTINUE " + masterRunId + "\r\n";
+        reply.raw(continueResponse);
         
         std::cout << "Sending CONTINUE response for partial resync from offset " << requestedOffset << "\n";
-        
-        // Update replica information
-        struct sockaddr_in addr;
-        socklen_t addrLen = sizeof(addr);
-        getpeername(clientSocket, (struct sockaddr*)&addr, &addrLen);
-        
-        char ip[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &(addr.sin_addr), ip, INET_ADDRSTRLEN);
-        int port = ntohs(addr.sin_port);
-        
-        std::string host(ip);
-        
-        // Update replica offset
-        {
-            std::lock_guard<std::mutex> lock(mutex);
-            for (auto& replica : replicas) {
-                if (replica.host == host && replica.port == port) {
-                    replica.socket = clientSocket;
-                    replica.connected = true;
-                    replica.offset = requestedOffset;
-                    break;
-                }
-            }
-        }
     }
     else {
-        // Full resync
-        std::string fullResyncResponse = "+FULLRESYNC " + masterRunId + " " + std::to_string(replicationOffset) + "\r\n";
-        if (send(clientSocket, fullResyncResponse.c_str(), fullResyncResponse.length(), 0) < 0) {
-            std::cerr << "Error sending FULLRESYNC response\n";
-            return;
-        }
-        
-        std::cout << "Sending FULLRESYNC response (offset in future): " << fullResyncResponse;
-        
-        // Send RDB snapshot as above
-        std::string rdbSnapshot = generateRDBSnapshot();
-        std::string rdbHeader = "$" + std::to_string(rdbSnapshot.size()) + "\r\n";
-        
-        if (send(clientSocket, rdbHeader.c_str(), rdbHeader.length(), 0) < 0) {
-            std::cerr << "Error sending RDB header\n";
-            return;
-        }
-        
-        if (send(clientSocket, rdbSnapshot.c_str(), rdbSnapshot.size(), 0) < 0) {
-            std::cerr << "Error sending RDB data\n";
+        std::cout << "Replica offset " << requestedOffset << " is in the future, doing a full resync\n";
+        fullResync(conn, reply);
+    }
+}
+
+void MasterServer::fullResync(Connection& conn, ReplyBuilder& reply) {
+    std::string rdbSnapshot;
+    long long offset;
+    {
+        // no write is between changing the keyspace and propagating it while we hold this, so
+        // every write is either in the snapshot or streamed after it. mutex stays free: INFO,
+        // WAIT and closing replicas don't wait for the encoding.
+        std::unique_lock<std::shared_mutex> gate(writeGate);
+        rdbSnapshot = generateRDBSnapshot();
+        offset = replicationOffset;
+        registerReplica(conn, offset);
+    }
+
+    // writes propagated from here on are posted to conn's loop, which is this thread, so they
+    // are queued only after this command's reply
+    std::string fullResyncResponse = "+FULLRESYNC " + masterRunId + " " + std::to_string(offset) + "\r\n";
+    reply.raw(fullResyncResponse);
+    
+    std::cout << "Sending FULLRESYNC response: " << fullResyncResponse;
+    
+    // Send RDB snapshot as a RESP bulk string
+    reply.bulkString(rdbSnapshot);
+    
+    std::cout << "Sent RDB snapshot, size: " << rdbSnapshot.size() << " bytes\n";
+}
+
+void MasterServer::registerReplica(Connection& conn, long long offset) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& replica : replicas) {
+        if (replica.host == conn.peerIP && replica.port == conn.peerPort) {
+            // Update existing replica
+            replica.socket = conn.fd;
+            replica.loop = conn.loop;
+            replica.connectionId = conn.id;
+            replica.connected = true;
+            replica.offset = offset;
+            replica.lastIoMs = ServerClock::monotonicMs();
             return;
         }
-        
-        // Additional CRLF after RDB data
-        std::string crlf = "\r\n";
-        if (send(clientSocket, crlf.c_str(), crlf.length(), 0) < 0) {
-            std::cerr << "Error sending CRLF after RDB data\n";
+    }
+    
+    // Add new replica
+    replicas.emplace_back(conn.peerIP, conn.peerPort);
+    replicaCount.store(replicas.size(), std::memory_order_release);
+    ReplicaInfo& replica = replicas.back();
+    replica.socket = conn.fd;
+    replica.loop = conn.loop;
+    replica.connectionId = conn.id;
+    replica.connected = true;
+    replica.offset = offset;
+    replica.lastIoMs = ServerClock::monotonicMs();
+    
+    std::cout << "Added new replica: " << conn.peerIP << ":" << conn.peerPort << "\n";
+}
+
+void MasterServer::replicaClosed(const Connection& conn) {
+    if (replicaCount.load(std::memory_order_acquire) == 0) return;  // runs on every client close
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = replicas.begin(); it != replicas.end(); ++it) {
+        if (it->loop == conn.loop && it->connectionId == conn.id) {
+            // it reconnects from a new port with a fresh PSYNC, which registers it again
+            std::cout << "Replica " << it->host << ":" << it->port << " disconnected\n";
+            replicas.erase(it);
+            replicaCount.store(replicas.size(), std::memory_order_release);
             return;
         }
-        
-        std::cout << "Sent RDB snapshot, size: " << rdbSnapshot.size() << " bytes\n";
-        
     }
 }
 
@@ -4,6 +4,8 @@
 #include <string>
 #include <vector>
 #include <mutex>
+#include <shared_mutex>
+#include <atomic>
 #include <random>
 #include <iostream>
 #include <cstdlib>
@@ -13,9 +15,17 @@
 #include <arpa/inet.h>
 #include "DB.hpp"
 #include "ReplicaConnection.hpp"
+#include "reply_builder.hpp"
+#include "resp_parser.hpp"
+
+class EventLoop;
+struct Connection;
 
 class MasterServer {
 private:
+    // A replica we dialed ourselves (--replica) has a blocking socket that is ours to send on
+    // and close. One that connected to us and sent PSYNC lives on an event loop: its socket
+    // belongs to that loop's thread, so output is posted there and queued on the connection.
     struct ReplicaInfo {
         int socket;
         struct sockaddr_in addr;
@@ -23,9 +33,13 @@ private:
         std::string host;
         bool connected;
         long long offset;
+        long long lastIoMs;  // last successful send, on ServerClock::monotonicMs
+        EventLoop* loop;          // owning loop of a PSYNC replica's connection, else nullptr
+        uint64_t connectionId;    // that connection's id, since its fd may be reused
         
         ReplicaInfo(const std::string& h, int p) : 
-            socket(-1), port(p), host(h), connected(false), offset(0) {
+            socket(-1), port(p), host(h), connected(false), offset(0), lastIoMs(0),
+            loop(nullptr), connectionId(0) {
             addr.sin_family = AF_INET;
             addr.sin_port = htons(port);
             addr.sin_addr.s_addr = inet_addr(host.c_str());
@@ -34,6 +48,13 @@ private:
     
     std::vector<ReplicaInfo> replicas;
     std::mutex mutex;
+    // Held shared by a write from the moment it changes the keyspace until it is propagated,
+    // and exclusively by PSYNC while it snapshots and registers the replica, so each write
+    // reaches a new replica either in its snapshot or in its stream, never both or neither.
+    // Lock order: writeGate, then mutex.
+    std::shared_mutex writeGate;
+    // replicas.size(), readable without mutex so writes skip propagation when there are none
+    std::atomic<size_t> replicaCount{0};
     int masterPort;
     std::string masterId;
     std::string masterRunId;
@@ -42,7 +63,7 @@ private:
 
     std::string generateMasterRunId();
     
-    std::string formatRESP(const std::vector<std::string> &args);
+    std::string formatRESP(const CommandArgs& args);
     
     bool performReplicationHandshake(ReplicaInfo& replica);
     
@@ -51,8 +72,18 @@ private:
     void connectToAllReplicas();
     
     std::string generateRDBSnapshot();
+
+    // Connected replicas that have been sent everything up to offset.
+    int countReplicasAt(long long offset);
     
-    void handlePSYNC(int clientSocket, const std::vector<RESPElement>& args);
+    void handlePSYNC(Connection& conn, const CommandArgs& args, ReplyBuilder& reply);
+
+    // Reply +FULLRESYNC and the snapshot, and start streaming writes to conn.
+    void fullResync(Connection& conn, ReplyBuilder& reply);
+
+    // Record conn as the link to the replica at its peer address. Caller holds writeGate
+    // exclusively.
+    void registerReplica(Connection& conn, long long offset);
 
 public:
     MasterServer(int port);
@@ -63,11 +94,21 @@ public:
     
     void removeReplica(const std::string& host, int port);
     
-    bool sendCommand(const std::vector<std::string> &cmdArgs);
+    bool sendCommand(const CommandArgs& cmdArgs);
     
-    bool propagateWrite(const std::vector<std::string> &cmdArgs);
-    
-    void handleReplicationCommand(int clientSocket, const std::vector<RESPElement>& args);
+    bool propagateWrite(const CommandArgs& cmdArgs);
+
+    // Taken around every write that is propagated: the keyspace change and its propagateWrite()
+    // must happen under one hold.
+    std::shared_lock<std::shared_mutex> lockWrites() {
+        return std::shared_lock<std::shared_mutex>(writeGate);
+    }
+    
+    // replies are appended to reply; conn is only kept to register a PSYNC replica
+    void handleReplicationCommand(Connection& conn, const CommandArgs& args, ReplyBuilder& reply);
+
+    // Event loop close hook: forget the replica streaming over conn, if any.
+    void replicaClosed(const Connection& conn);
     
     std::string getMasterInfo() const;
     
@@ -0,0 +1,233 @@
+#include "QuickList.hpp"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <utility>
+
+QuickList::QuickList(QuickList&& other) noexcept
+    : head_(other.head_), tail_(other.tail_), count_(other.count_), bytes_(other.bytes_) {
+    other.head_ = other.tail_ = nullptr;
+    other.count_ = other.bytes_ = 0;
+}
+
+QuickList& QuickList::operator=(QuickList&& other) noexcept {
+    QuickList taken(std::move(other));  // our old blocks leave with it
+    std::swap(head_, taken.head_);
+    std::swap(tail_, taken.tail_);
+    std::swap(count_, taken.count_);
+    std::swap(bytes_, taken.bytes_);
+    return *this;
+}
+
+QuickList::~QuickList() {
+    Block* block = head_;
+    while (block) {
+        Block* next = block->next;
+        ::operator delete(block);
+        block = next;
+    }
+}
+
+void QuickList::writeEntry(char* pos, std::string_view value) {
+    uint32_t length = static_cast<uint32_t>(value.size());
+    if (length < LONG_LENGTH) {
+        *pos++ = static_cast<char>(length);
+        std::memcpy(pos, value.data(), length);
+        pos[length] = static_cast<char>(length);
+        return;
+    }
+    // long form: marker then length up front, length then marker at the back
+    *pos++ = static_cast<char>(LONG_LENGTH);
+    std::memcpy(pos, &length, sizeof(length));
+    pos += sizeof(length);
+    std::memcpy(pos, value.data(), length);
+    pos += length;
+    std::memcpy(pos, &length, sizeof(length));
+    pos[sizeof(length)] = static_cast<char>(LONG_LENGTH);
+}
+
+std::string_view QuickList::readEntry(const char* pos) {
+    uint8_t first = static_cast<uint8_t>(*pos);
+    if (first != LONG_LENGTH) return {pos + 1, first};
+    uint32_t length;
+    std::memcpy(&length, pos + 1, sizeof(length));
+    return {pos + 1 + sizeof(length), length};
+}
+
+std::string_view QuickList::readEntryBackward(const char* end) {
+    uint8_t last = static_cast<uint8_t>(end[-1]);
+    if (last != LONG_LENGTH) return {end - 1 - last, last};
+    uint32_t length;
+    std::memcpy(&length, end - 1 - sizeof(length), sizeof(length));
+    return {end - 1 - sizeof(length) - length, length};
+}
+
+QuickList::Block* QuickList::allocateBlock(size_t needed, bool fillFromEnd) {
+    // only a list's first block starts small; once one block has filled up the list is
+    // long enough that full-sized blocks are a small part of it
+    size_t capacity = std::max(head_ ? BLOCK_BYTES : MIN_BLOCK_BYTES, needed);
+    void* memory = ::operator new(sizeof(Block) + capacity);
+    uint32_t start = fillFromEnd ? static_cast<uint32_t>(capacity) : 0;
+    bytes_ += sizeof(Block) + capacity;
+    return new (memory) Block{nullptr, nullptr, static_cast<uint32_t>(capacity), start, start, 0};
+}
+
+QuickList::Block* QuickList::makeRoom(Block* block, size_t needed, bool atFront) {
+    size_t used = block->end - block->begin;
+    size_t capacity = block->capacity;
+    // sliding in place only pays when it frees a fair share of the block; otherwise grow,
+    // or have the caller start a new block once this one is at BLOCK_BYTES
+    if (used + needed > capacity || capacity - used < capacity / 4) {
+        if (capacity >= BLOCK_BYTES || used + needed > BLOCK_BYTES) return nullptr;
+        capacity = std::min(BLOCK_BYTES, std::max(2 * capacity, used + needed));
+    }
+    // a list's only block is pushed at both ends, so the spare room is split between them
+    // and alternating pushes don't move the elements each time; any other block is only
+    // ever pushed on this side
+    size_t spare = capacity - used - needed;
+    size_t otherSide = head_ == tail_ ? spare / 2 : 0;
+    uint32_t begin = static_cast<uint32_t>(atFront ? capacity - used - otherSide : otherSide);
+    if (capacity == block->capacity) {
+        std::memmove(block->data() + begin, block->data() + block->begin, used);
+        block->begin = begin;
+        block->end = begin + static_cast<uint32_t>(used);
+        return block;
+    }
+
+    void* memory = ::operator new(sizeof(Block) + capacity);
+    Block* grown = new (memory) Block{block->prev, block->next, static_cast<uint32_t>(capacity), begin,
+                                      begin + static_cast<uint32_t>(used), block->count};
+    std::memcpy(grown->data() + begin, block->data() + block->begin, used);
+    if (grown->prev) grown->prev->next = grown;
+    else head_ = grown;
+    if (grown->next) grown->next->prev = grown;
+    else tail_ = grown;
+    bytes_ += capacity - block->capacity;
+    ::operator delete(block);
+    return grown;
+}
+
+void QuickList::freeBlock(Block* block) {
+    unlink(block);
+    bytes_ -= sizeof(Block) + block->capacity;
+    ::operator delete(block);
+}
+
+void QuickList::unlink(Block* block) {
+    if (block->prev) block->prev->next = block->next;
+    else head_ = block->next;
+    if (block->next) block->next->prev = block->prev;
+    else tail_ = block->prev;
+}
+
+void QuickList::pushFront(std::string_view value) {
+    size_t needed = entrySize(value.size());
+    if (!head_ || (head_->begin < needed && !makeRoom(head_, needed, true))) {
+        Block* block = allocateBlock(needed, true);
+        block->next = head_;
+        if (head_) head_->prev = block;
+        else tail_ = block;
+        head_ = block;
+    }
+    head_->begin -= static_cast<uint32_t>(needed);
+    writeEntry(head_->data() + head_->begin, value);
+    head_->count++;
+    count_++;
+}
+
+void QuickList::pushBack(std::string_view value) {
+    size_t needed = entrySize(value.size());
+    if (!tail_ || (tail_->capacity - tail_->end < needed && !makeRoom(tail_, needed, false))) {
+        Block* block = allocateBlock(needed, false);
+        block->prev = tail_;
+        if (tail_) tail_->next = block;
+        else head_ = block;
+        tail_ = block;
+    }
+    writeEntry(tail_->data() + tail_->end, value);
+    tail_->end += static_cast<uint32_t>(needed);
+    tail_->count++;
+    count_++;
+}
+
+std::optional<std::string> QuickList::popFront() {
+    if (!head_) return std::nullopt;
+    std::string_view element = readEntry(head_->data() + head_->begin);
+    std::string value(element);
+    head_->begin += static_cast<uint32_t>(entrySize(element.size()));
+    count_--;
+    if (--head_->count == 0) freeBlock(head_);
+    return value;
+}
+
+std::optional<std::string> QuickList::popBack() {
+    if (!tail_) return std::nullopt;
+    std::string_view element = readEntryBackward(tail_->data() + tail_->end);
+    std::string value(element);
+    tail_->end -= static_cast<uint32_t>(entrySize(element.size()));
+    count_--;
+    if (--tail_->count == 0) freeBlock(tail_);
+    return value;
+}
+
+void QuickList::dropFront(size_t count) {
+    count = std::min(count, count_);
+    count_ -= count;
+    while (count > 0) {
+        if (count >= head_->count) {
+            count -= head_->count;
+            freeBlock(head_);
+            continue;
+        }
+        head_->count -= static_cast<uint32_t>(count);
+        for (; count > 0; count--) {
+            head_->begin += static_cast<uint32_t>(entrySize(readEntry(head_->data() + head_->begin).size()));
+        }
+    }
+}
+
+void QuickList::dropBack(size_t count) {
+    count = std::min(count, count_);
+    count_ -= count;
+    while (count > 0) {
+        if (count >= tail_->count) {
+            count -= tail_->count;
+            freeBlock(tail_);
+            continue;
+        }
+        tail_->count -= static_cast<uint32_t>(count);
+        for (; count > 0; count--) {
+            tail_->end -= static_cast<uint32_t>(entrySize(readEntryBackward(tail_->data() + tail_->end).size()));
+        }
+    }
+}
+
+const QuickList::Block* QuickList::locate(size_t index, size_t& within) const {
+    // whole blocks are skipped by their counts, walking in from the nearer end
+    if (index < count_ / 2) {
+        for (const Block* block = head_; block; block = block->next) {
+            if (index < block->count) {
+                within = index;
+                return block;
+            }
+            index -= block->count;
+        }
+        return nullptr;
+    }
+    size_t fromTail = count_ - 1 - index;
+    for (const Block* block = tail_; block; block = block->prev) {
+        if (fromTail < block->count) {
+            within = block->count - 1 - fromTail;
+            return block;
+        }
+        fromTail -= block->count;
+    }
+    return nullptr;
+}
+
+std::optional<std::string> QuickList::at(size_t index) const {
+    if (index >= count_) return std::nullopt;
+    std::optional<std::string> value;
+    forRange(index, index, [&value](std::string_view element) { value.emplace(element); });
+    return value;
+}
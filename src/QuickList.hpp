@@ -0,0 +1,118 @@
+#ifndef QUICK_LIST_HPP
+#define QUICK_LIST_HPP
+
+#include <string>
+#include <string_view>
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+
+// List value: a doubly-linked chain of blocks, each packing its elements as
+// length-prefixed (and length-suffixed, so they can be walked backwards) byte runs.
+// Blocks created by a head push fill from their end towards their start, blocks created by
+// a tail push the other way round, so pushes and pops at either end touch one block.
+// Like the listpacks of Redis's quicklist, a list's first block is sized to its data and
+// doubles as it fills, up to BLOCK_BYTES; later blocks start full-sized. An element larger
+// than a block gets a block of its own. Not thread-safe: the owning shard's lock covers it.
+class QuickList {
+public:
+    static constexpr size_t BLOCK_BYTES = 8192;
+    static constexpr size_t MIN_BLOCK_BYTES = 32;
+
+    QuickList() = default;
+    QuickList(QuickList&& other) noexcept;
+    QuickList& operator=(QuickList&& other) noexcept;
+    ~QuickList();
+
+    QuickList(const QuickList&) = delete;
+    QuickList& operator=(const QuickList&) = delete;
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    // heap bytes held by the blocks, headers included
+    size_t bytes() const { return bytes_; }
+
+    void pushFront(std::string_view value);
+    void pushBack(std::string_view value);
+    std::optional<std::string> popFront();
+    std::optional<std::string> popBack();
+
+    // drop count elements from the head / tail, whole blocks at a time where possible
+    void dropFront(size_t count);
+    void dropBack(size_t count);
+
+    // element at index (0 is the head), or nullopt if out of range
+    std::optional<std::string> at(size_t index) const;
+
+    // Call fn(std::string_view) for elements start..stop inclusive, in order.
+    // Requires start <= stop < size().
+    template <typename Fn>
+    void forRange(size_t start, size_t stop, Fn&& fn) const {
+        size_t remaining = stop - start + 1;
+        size_t skip;
+        const Block* block = locate(start, skip);
+        for (; block && remaining > 0; block = block->next, skip = 0) {
+            const char* pos = block->data() + block->begin;
+            for (size_t i = 0; i < block->count && remaining > 0; i++) {
+                std::string_view element = readEntry(pos);
+                pos = element.data() + element.size() + trailerSize(element.size());
+                if (i < skip) continue;
+                fn(element);
+                remaining--;
+            }
+        }
+    }
+
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        if (count_ > 0) forRange(0, count_ - 1, fn);
+    }
+
+private:
+    // Header plus data()[0, capacity). Elements occupy [begin, end).
+    struct Block {
+        Block* prev;
+        Block* next;
+        uint32_t capacity;
+        uint32_t begin;
+        uint32_t end;
+        uint32_t count;
+
+        char* data() { return reinterpret_cast<char*>(this + 1); }
+        const char* data() const { return reinterpret_cast<const char*>(this + 1); }
+    };
+
+    // lengths under 128 take one byte on each side of the element, longer ones five
+    static constexpr uint8_t LONG_LENGTH = 0x80;
+
+    Block* head_ = nullptr;
+    Block* tail_ = nullptr;
+    size_t count_ = 0;
+    size_t bytes_ = 0;
+
+    static size_t headerSize(size_t length) { return length < LONG_LENGTH ? 1 : 5; }
+    static size_t trailerSize(size_t length) { return headerSize(length); }
+    static size_t entrySize(size_t length) { return headerSize(length) + length + trailerSize(length); }
+
+    // encode value at pos (entrySize(value.size()) bytes)
+    static void writeEntry(char* pos, std::string_view value);
+    // element whose header starts at pos
+    static std::string_view readEntry(const char* pos);
+    // element whose trailer ends just before end
+    static std::string_view readEntryBackward(const char* end);
+
+    // new unlinked block; fillFromEnd places the first element at the end of its data
+    Block* allocateBlock(size_t needed, bool fillFromEnd);
+    // Make room for needed more bytes in front of (atFront) or behind the elements of the
+    // head/tail block: slide them over if a quarter of the block or more is free, else move
+    // them to a block of twice the capacity. Returns the block, which may have moved, or
+    // nullptr if it cannot grow past BLOCK_BYTES and a new block is needed.
+    Block* makeRoom(Block* block, size_t needed, bool atFront);
+    void freeBlock(Block* block);
+    void unlink(Block* block);
+
+    // block holding index and how many elements of it come before index
+    const Block* locate(size_t index, size_t& within) const;
+};
+
+#endif // QUICK_LIST_HPP
@@ -1,8 +1,10 @@
 #include "ReplicaConnection.hpp"
 
 ReplicaConnection::ReplicaConnection(int port, std::string replicaOfHost, int replicaOfPort)
-    : listeningPort(port), offset(0), serverSocket(-1), stop(false), 
-      masterPort(0), masterLink(false), masterLastIoTime(0) {
+    : listeningPort(port), offset(0), serverSocket(-1), stop(false),
+      eventLoop([this](Connection& conn) { handleClientData(conn); },
+                [this](Connection& conn) { conn.fromMaster = isMasterConnection(conn.peerIP.c_str(), conn.peerPort); }),
+      masterPort(0), masterLink(false), masterLastIoMs(0) {
     runId = generateRunId();
 
     // run client listening thread AND master comm thread
@@ -19,10 +21,7 @@ ReplicaConnection::ReplicaConnection(int port, std::string replicaOfHost, int re
 
 ReplicaConnection::~ReplicaConnection() {
     stop = true;
-    
-    if (serverSocket != -1) {
-        close(serverSocket);
-    }
+    eventLoop.stop();
     
     if (serverThread.joinable()) {
         serverThread.join();
@@ -31,34 +30,20 @@ ReplicaConnection::~ReplicaConnection() {
     if (masterConnectionThread.joinable()) {
         masterConnectionThread.join();
     }
-    
-    {
-        std::lock_guard<std::mutex> lock(clientThreadsMutex);
-        for (auto& thread : clientThreads) {
-            if (thread.joinable()) {
-                thread.join();
-            }
-        }
-        clientThreads.clear();
-    }
-}
-
-std::string ReplicaConnection::formatRespString(const std::string& str) {
-    return "+" + str + "\r\n";
 }
 
-std::string ReplicaConnection::formatRespError(const std::string& str) {
-    return "-" + str + "\r\n";
-}
-
-std::string ReplicaConnection::formatRespBulkString(const std::string& str) {
-    return "$" + std::to_string(str.length()) + "\r\n" + str + "\r\n";
+void ReplicaConnection::wait() {
+    if (serverThread.joinable()) {
+        serverThread.join();
+    }
 }
 
-std::string ReplicaConnection::formatRESP(const std::vector<std::string>& args) {
+std::string ReplicaConnection::formatRESP(const CommandArgs& args) {
     std::string resp = "*" + std::to_string(args.size()) + "\r\n";
     for (const auto& arg : args) {
-        resp += "$" + std::to_string(arg.length()) + "\r\n" + arg + "\r\n";
+        resp += "$" + std::to_string(arg.length()) + "\r\n";
+        resp.append(arg);
+        resp += "\r\n";
     }
     return resp;
 }
@@ -69,7 +54,7 @@ std::string ReplicaConnection::toUpper(const std::string& str) {
     return result;
 }
 
-// creates a separate thread for each client
+// serves every client from one event loop on the server thread
 void ReplicaConnection::serverLoop() {
     serverSocket = socket(AF_INET, SOCK_STREAM, 0);
     if (serverSocket < 0) {
@@ -96,7 +81,7 @@ void ReplicaConnection::serverLoop() {
         return;
     }
 
-    if (listen(serverSocket, 5) < 0) {
+    if (listen(serverSocket, SOMAXCONN) < 0) {
         std::cerr << "Error listening on port " << listeningPort << "\n";
         close(serverSocket);
         return;
@@ -104,150 +89,73 @@ void ReplicaConnection::serverLoop() {
 
     std::cout << "Replica listening on port " << listeningPort << std::endl;
 
-    while (!stop) {
-        struct sockaddr_in clientAddr;
-        socklen_t addrSize = sizeof(clientAddr);
-        int clientSocket = accept(serverSocket, (struct sockaddr *)&clientAddr, &addrSize);
-        
-        if (clientSocket < 0) {
-            if (stop) break;
-            std::cerr << "Error accepting connection\n";
-            continue;
-        }
-        
-        // create new thread to handle this client connection
-        std::thread clientThread(&ReplicaConnection::handleClientConnection, this, clientSocket);
-        
-        {
-            std::lock_guard<std::mutex> lock(clientThreadsMutex);
-            
-            // Clean up finished client threads
-            for (auto it = clientThreads.begin(); it != clientThreads.end();) {
-                if (!it->joinable()) {
-                    it = clientThreads.erase(it);
-                } else {
-                    ++it;
-                }
-            }
-            
-            // Add the new client thread
-            clientThreads.push_back(std::move(clientThread));
-        }
+    eventLoop.runEvery(std::chrono::milliseconds(DB::CRON_INTERVAL_MS), [] { DB::getInstance().cron(); });
+    if (eventLoop.addListener(serverSocket)) {
+        eventLoop.run();
     }
 
     close(serverSocket);
     serverSocket = -1;
 }
 
-void ReplicaConnection::handleClientConnection(int clientSocket) {
-    // Get client IP and port for identifying if it's the master
-    struct sockaddr_in clientAddr;
-    socklen_t addrLen = sizeof(clientAddr);
-    getpeername(clientSocket, (struct sockaddr*)&clientAddr, &addrLen);
-    
-    char clientIP[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &(clientAddr.sin_addr), clientIP, INET_ADDRSTRLEN);
-    int clientPort = ntohs(clientAddr.sin_port);
-    
-    // Check if this connection is from our configured master
-    bool isFromMaster = isMasterConnection(clientIP, clientPort);
-    
-    // Buffer for accumulating data from potentially multiple recv calls
-    std::string commandBuffer;
-    char tempBuffer[1024];
-    bool commandComplete = false;
-    
+// Called by the event loop after each read cycle; processes every complete command in the buffer
+void ReplicaConnection::handleClientData(Connection& conn) {
+    std::string& commandBuffer = conn.readBuffer;
+    RESPParser& parser = conn.parser;
+    ReplyBuilder reply(conn.writeBuffer);
+
     while (!stop) {
-        commandBuffer.clear();
-        commandComplete = false;
-        
-        // Receive complete RESP command
-        while (!commandComplete && !stop) {
-            memset(tempBuffer, 0, sizeof(tempBuffer));
-            ssize_t bytesReceived = recv(clientSocket, tempBuffer, sizeof(tempBuffer) - 1, 0);
-            
-            if (bytesReceived <= 0) {
-                goto cleanup;  
-            }
-            
-            commandBuffer.append(tempBuffer, bytesReceived);
-            
-            try {
-                RESPParser parser;
-                RESPElement parsedCommand = parser.parse(commandBuffer);
-                commandComplete = true; 
-            } catch (const std::exception& e) {
-                std::string error = e.what();
-                if (error.find("Incomplete") != std::string::npos) {
-                    // Need more data, continue receiving
-                    continue;
-                } else {
-                    std::cerr << "Error parsing command: " << error << std::endl;
-                    std::string errorResponse = "-ERR invalid command format\r\n";
-                    send(clientSocket, errorResponse.c_str(), errorResponse.length(), 0);
-                    commandComplete = true;  
-                }
-            }
+        size_t commandStart = parser.position();
+        CommandArgs args;
+        ParseStatus status = parser.parse(commandBuffer, args);
+        if (status == ParseStatus::NeedMore) {
+            // Need more data, wait for next read
+            break;
         }
-        
-        if (!stop && !commandBuffer.empty()) {
-            processCommand(commandBuffer, clientSocket, isFromMaster);
+        if (status == ParseStatus::Error) {
+            std::cerr << "Error parsing command: " << parser.errorMessage() << std::endl;
+            reply.error("ERR invalid command format");
+            parser.reset();
+            commandBuffer.clear();
+            return;
         }
+        processCommand(args, parser.position() - commandStart, conn.fd, conn.fromMaster, reply);
     }
-
-cleanup:
-    close(clientSocket);
+    parser.discardConsumed(commandBuffer);
 }
 
 // Process command from client or master (just in case master connects here)
-void ReplicaConnection::processCommand(std::string& commandBuffer, int clientSocket, bool isFromMaster) {
+void ReplicaConnection::processCommand(const CommandArgs& args, size_t commandBytes, int clientSocket, bool isFromMaster, ReplyBuilder& reply) {
     try {
-        RESPParser parser;
-        RESPElement parsedCommand = parser.parse(commandBuffer);
-        
-        if (parsedCommand.type == RESPType::Array && !parsedCommand.array.empty()) {
-            std::string command = parsedCommand.array[0].value;
-            std::transform(command.begin(), command.end(), command.begin(), ::toupper);
-            
-            std::cout << "Received command " << command << " from " 
-                      << (isFromMaster ? "master" : "client") << std::endl;
-            
+        if (!args.empty()) {
             if (isFromMaster) {
-                processCommandFromMaster(commandBuffer);
-                std::string okResponse = "+OK\r\n";
-                send(clientSocket, okResponse.c_str(), okResponse.length(), 0);
+                processCommandFromMaster(args, commandBytes);
+                reply.simpleString("OK");
+                return;
+            }
+
+            // Client commands
+            const CommandSpec* cmd = lookupCommand(args[0]);
+            if (!cmd || cmd->hasFlag(CMD_MASTER_ONLY)) {
+                reply.error("ERR unknown command '" + std::string(args[0]) + "'");
+            }
+            else if (!cmd->arityMatches(args.size())) {
+                replyWrongArity(reply, args[0]);
+            }
+            else if (cmd->hasFlag(CMD_REPLICATION)) {
+                handleReplicationCommand(clientSocket, args, reply);
             }
-            else {   // Client commands
-                if (command == "REPLCONF" || command == "PSYNC" || 
-                    command == "INFO" || command == "WAIT") {
-                    handleReplicationCommand(clientSocket, parsedCommand.array);
-                }
-                else if (command == "GET") {
-                    handler.handleGet(clientSocket, parsedCommand.array);
-                }
-                else if (command == "EXISTS") {
-                    handler.handleExists(clientSocket, parsedCommand.array);
-                }
-                else if (command == "PING") {
-                    std::string pongResponse = "+PONG\r\n";
-                    send(clientSocket, pongResponse.c_str(), pongResponse.length(), 0);
-                }  
-                // Reject writes on replica
-                else if (command == "SET" || command == "DEL" || command == "INCR" ||
-                         command == "DECR" || command == "LPUSH" || command == "RPUSH") {
-                    std::string errorResponse = "-ERR READONLY You can't write against a read only replica.\r\n";
-                    send(clientSocket, errorResponse.c_str(), errorResponse.length(), 0);
-                }
-                else {
-                    std::string errorResponse = "-ERR unknown command '" + command + "'\r\n";
-                    send(clientSocket, errorResponse.c_str(), errorResponse.length(), 0);
-                }
+            else if (cmd->hasFlag(CMD_WRITE)) {  // Reject writes on replica
+                reply.error("ERR READONLY You can't write against a read only replica.");
+            }
+            else {
+                CommandContext ctx{args, reply, handler, nullptr, nullptr};
+                cmd->proc(ctx);
             }
         }
     } catch (const std::exception& e) {
         std::cerr << "Error processing command: " << e.what() << std::endl;
-        std::string errorResponse = "-ERR internal error\r\n";
-        send(clientSocket, errorResponse.c_str(), errorResponse.length(), 0);
+        reply.error("ERR internal error");
     }
 }
 
@@ -275,54 +183,30 @@ void ReplicaConnection::connectToMaster() {
     sendPSyncToMaster();
 }
 
-void ReplicaConnection::processCommandFromMaster(const std::string& cmd) {
+// commandBytes is the encoded size of the command, which advances our replication offset
+void ReplicaConnection::processCommandFromMaster(const CommandArgs& args, size_t commandBytes) {
     // Update replication status
-    offset += cmd.length();
-    masterLastIoTime = time(NULL);
+    offset += commandBytes;
+    masterLastIoMs = ServerClock::monotonicMs();
     
-    // Parse RESP formatted command
-    RESPParser parser;
     try {
-        RESPElement parsed = parser.parse(cmd);
-        
-        if (parsed.type == RESPType::Array && !parsed.array.empty()) {
-            std::string command = parsed.array[0].value;
-            std::transform(command.begin(), command.end(), command.begin(), ::toupper);
+        if (!args.empty()) {
+            // writes from the master are applied without replying; nothing is encoded or sent
+            ReplyBuilder discard;
             
-            std::cout << "Replica executing: " << command;
-            if (parsed.array.size() > 1) {
-                std::cout << " " << parsed.array[1].value;
+            const CommandSpec* cmd = lookupCommand(args[0]);
+            if (!cmd || !cmd->arityMatches(args.size())) {
+                std::cerr << "Replica: Unhandled command from master: " << args[0] << std::endl;
             }
-            std::cout << std::endl;
-            
-            if (command == "REPLCONF" || command == "PSYNC" || command == "PING" || command == "WAIT") {
-                handleReplicationCommand(-1, parsed.array);
-                return;
+            else if (cmd->hasFlag(CMD_REPLICATION)) {
+                handleReplicationCommand(-1, args, discard);
             }
-            
-            // for internal operations
-            int internalFd = -1;
-            
-            if (command == "SET") {
-                handler.handleSet(internalFd, parsed.array);
-            } 
-            else if (command == "DEL") {
-                handler.handleDel(internalFd, parsed.array);
-            } 
-            else if (command == "INCR") {
-                handler.handleIncr(internalFd, parsed.array);
-            } 
-            else if (command == "DECR") {
-                handler.handleDecr(internalFd, parsed.array);
-            } 
-            else if (command == "LPUSH") {
-                handler.handleLPush(internalFd, parsed.array);
-            } 
-            else if (command == "RPUSH") {
-                handler.handleRPush(internalFd, parsed.array);
+            else if (!cmd->hasFlag(CMD_MASTER_ONLY)) {  // writes; reads and PING are harmless no-ops
+                CommandContext ctx{args, discard, handler, nullptr, nullptr};
+                cmd->proc(ctx);
             }
             else {
-                std::cerr << "Replica: Unhandled command from master: " << command << std::endl;
+                std::cerr << "Replica: Unhandled command from master: " << args[0] << std::endl;
             }
         }
     } 
@@ -331,99 +215,91 @@ void ReplicaConnection::processCommandFromMaster(const std::string& cmd) {
     }
 }
 
-void ReplicaConnection::handleReplicationCommand(int fd, const std::vector<RESPElement>& args) {
+void ReplicaConnection::handleReplicationCommand(int fd, const CommandArgs& args, ReplyBuilder& reply) {
     if (args.empty()) return;
     
-    std::string command = args[0].value;
-    std::transform(command.begin(), command.end(), command.begin(), ::toupper);
+    std::string_view command = args[0];
     
-    if (command == "REPLCONF") {
-        handleReplConf(fd, args);
+    if (equalsIgnoreCase(command, "REPLCONF")) {
+        handleReplConf(args, reply);
     } 
-    else if (command == "PSYNC") {
-        handlePSync(fd, args);
+    else if (equalsIgnoreCase(command, "PSYNC")) {
+        handlePSync(fd, args, reply);
     } 
-    else if (command == "INFO") {
-        handleInfo(fd, args);
+    else if (equalsIgnoreCase(command, "INFO")) {
+        handleInfo(args, reply);
     } 
-    else if (command == "WAIT") {
-        handleWait(fd, args);
+    else if (equalsIgnoreCase(command, "WAIT")) {
+        handleWait(args, reply);
     }
 }
 
-void ReplicaConnection::handleReplConf(int fd, const std::vector<RESPElement>& args) {
+void ReplicaConnection::handleReplConf(const CommandArgs& args, ReplyBuilder& reply) {
     if (args.size() < 2) {
-        std::string response = formatRespError("ERR wrong number of arguments for 'REPLCONF' command");
-        send(fd, response.c_str(), response.length(), 0);
+        reply.error("ERR wrong number of arguments for 'REPLCONF' command");
         return;
     }
     
-    std::string subCommand = args[1].value;
+    std::string subCommand(args[1]);
     std::transform(subCommand.begin(), subCommand.end(), subCommand.begin(), ::toupper);
     
     if (subCommand == "LISTENING-PORT" && args.size() >= 3) {
         // Master telling its listening port or client configuring master port
-        int port = std::stoi(args[2].value);
+        int port = std::stoi(std::string(args[2]));
         std::cout << "Received REPLCONF LISTENING-PORT " << port << std::endl;
         
-        std::string response = formatRespString("OK");
-        send(fd, response.c_str(), response.length(), 0);
+        reply.simpleString("OK");
     }
     else if (subCommand == "CAPA" && args.size() >= 3) {
         // Capability negotiation
         std::cout << "Received REPLCONF CAPA";
         for (size_t i = 2; i < args.size(); i++) {
-            std::cout << " " << args[i].value;
+            std::cout << " " << args[i];
         }
         std::cout << std::endl;
         
-        std::string response = formatRespString("OK");
-        send(fd, response.c_str(), response.length(), 0);
+        reply.simpleString("OK");
     }
     else if (subCommand == "ACK" && args.size() >= 3) {
         // Replication offset acknowledgment
-        long long receivedOffset = std::stoll(args[2].value);
+        long long receivedOffset = std::stoll(std::string(args[2]));
         std::cout << "Received REPLCONF ACK " << receivedOffset << std::endl;
         
-        std::string response = formatRespString("OK");
-        send(fd, response.c_str(), response.length(), 0);
+        reply.simpleString("OK");
     }
     else if (subCommand == "GETACK" && args.size() >= 2) {
         // Request for an ACK - respond with our current offset
         std::cout << "Received REPLCONF GETACK" << std::endl;
         
-        std::string ackResponse = "*3\r\n$8\r\nREPLCONF\r\n$3\r\nACK\r\n$" + 
-                                std::to_string(std::to_string(offset).length()) + 
-                                "\r\n" + std::to_string(offset) + "\r\n";
-        send(fd, ackResponse.c_str(), ackResponse.length(), 0);
+        reply.arrayHeader(3);
+        reply.bulkString("REPLCONF");
+        reply.bulkString("ACK");
+        reply.bulkString(std::to_string(offset));
     }
     else if ((subCommand == "MASTER-ID" || subCommand == "MASTER-RUNID") && args.size() >= 3) {
         // Master identifying itself to replica
-        std::string masterId = args[2].value;
+        std::string masterId(args[2]);
         std::cout << "Received REPLCONF " << subCommand << " " << masterId << std::endl;
         
         if (subCommand == "MASTER-RUNID") {
             replicationId = masterId;
         }
         
-        std::string response = formatRespString("OK");
-        send(fd, response.c_str(), response.length(), 0);
+        reply.simpleString("OK");
     }
     else {
-        std::string response = formatRespError("ERR unknown REPLCONF subcommand or wrong number of arguments");
-        send(fd, response.c_str(), response.length(), 0);
+        reply.error("ERR unknown REPLCONF subcommand or wrong number of arguments");
     }
 }
 
-void ReplicaConnection::handlePSync(int fd, const std::vector<RESPElement>& args) {
+void ReplicaConnection::handlePSync(int fd, const CommandArgs& args, ReplyBuilder& reply) {
     if (args.size() < 3) {
-        std::string response = formatRespError("ERR wrong number of arguments for 'PSYNC' command");
-        send(fd, response.c_str(), response.length(), 0);
+        reply.error("ERR wrong number of arguments for 'PSYNC' command");
         return;
     }
     
-    std::string requestedReplicationId = args[1].value;
-    long long requestedOffset = std::stoll(args[2].value);
+    std::string requestedReplicationId(args[1]);
+    long long requestedOffset = std::stoll(std::string(args[2]));
     
     std::cout << "Replica received PSYNC " << requestedReplicationId << " " << requestedOffset << std::endl;
     
@@ -433,23 +309,22 @@ void ReplicaConnection::handlePSync(int fd, const std::vector<RESPElement>& args
         std::string response = formatRESP({"REPLCONF", "listening-port", 
                                           std::to_string(listeningPort),
                                           "capa", "eof", "capa", "psync2"});
-        send(fd, response.c_str(), response.length(), 0);
+        reply.raw(response);
         
         // Send our replication status
         std::string replicationStatus = formatRESP({"REPLCONF", "ACK", 
                                                   std::to_string(offset)});
-        send(fd, replicationStatus.c_str(), replicationStatus.length(), 0);
+        reply.raw(replicationStatus);
     }
     else if (fd >= 0) {  // client denied psync
-        std::string response = formatRespError("ERR Can't PSYNC with a replica. If you want to subscribe to this replica's replication stream, use the SUBSCRIBE command.");
-        send(fd, response.c_str(), response.length(), 0);
+        reply.error("ERR Can't PSYNC with a replica. If you want to subscribe to this replica's replication stream, use the SUBSCRIBE command.");
     }
 }
 
-void ReplicaConnection::handleInfo(int fd, const std::vector<RESPElement>& args) {
+void ReplicaConnection::handleInfo(const CommandArgs& args, ReplyBuilder& reply) {
     std::string section = "all";
     if (args.size() > 1) {
-        section = args[1].value;
+        section = std::string(args[1]);
         std::transform(section.begin(), section.end(), section.begin(), ::tolower);
     }
     
@@ -461,7 +336,7 @@ void ReplicaConnection::handleInfo(int fd, const std::vector<RESPElement>& args)
         info += "master_host:" + (masterHost.empty() ? "none" : masterHost) + "\r\n";
         info += "master_port:" + (masterPort ? std::to_string(masterPort) : "0") + "\r\n";
         info += "master_link_status:" + std::string(masterLink ? "up" : "down") + "\r\n";
-        info += "master_last_io_seconds_ago:" + std::to_string(time(NULL) - masterLastIoTime) + "\r\n";
+        info += "master_last_io_seconds_ago:" + std::to_string((ServerClock::monotonicMs() - masterLastIoMs) / 1000) + "\r\n";
         info += "master_sync_in_progress:0\r\n";
         info += "slave_repl_offset:" + std::to_string(offset) + "\r\n";
         info += "slave_priority:100\r\n";
@@ -476,21 +351,27 @@ void ReplicaConnection::handleInfo(int fd, const std::vector<RESPElement>& args)
         info += "repl_backlog_first_byte_offset:0\r\n";
         info += "repl_backlog_histlen:" + std::to_string(offset) + "\r\n";
     }
+
+    if (section == "stats" || section == "all") {
+        if (!info.empty()) info += "\r\n";
+        info += DB::getInstance().infoStats();
+    }
+    if (section == "memory" || section == "all") {
+        if (!info.empty()) info += "\r\n";
+        info += DB::getInstance().infoMemory();
+    }
     
-    std::string response = formatRespBulkString(info);
-    send(fd, response.c_str(), response.length(), 0);
+    reply.bulkString(info);
 }
 
 // just respond to wait if caught up
-void ReplicaConnection::handleWait(int fd, const std::vector<RESPElement>& args) {
+void ReplicaConnection::handleWait(const CommandArgs& args, ReplyBuilder& reply) {
     if (args.size() < 3) {
-        std::string response = formatRespError("ERR wrong number of arguments for 'WAIT' command");
-        send(fd, response.c_str(), response.length(), 0);
+        reply.error("ERR wrong number of arguments for 'WAIT' command");
         return;
     }
     
-    std::string response = ":0\r\n";  // Integer reply in RESP
-    send(fd, response.c_str(), response.length(), 0);
+    reply.integer(0);
 }
 
 void ReplicaConnection::sendPSyncToMaster() {
@@ -598,6 +479,14 @@ void ReplicaConnection::processPSyncResponse(int masterSocket) {
     
     std::string response(buffer, bytesRead);
     
+    // the master pipelines the RDB payload and write stream right behind the status line,
+    // so whatever follows the first CRLF belongs to the next stage
+    std::string pending;
+    size_t statusEnd = response.find("\r\n");
+    if (statusEnd != std::string::npos) {
+        pending = response.substr(statusEnd + 2);
+    }
+    
     // Response is either +FULLRESYNC <replid> <offset> or +CONTINUE <replid>
     if (response.substr(0, 11) == "+FULLRESYNC") {
         // Extract the replication ID and offset
@@ -614,7 +503,9 @@ void ReplicaConnection::processPSyncResponse(int masterSocket) {
                     << ", Offset=" << offset << std::endl;
             
             // Receive and load the RDB file
-            receiveRDBFromMaster(masterSocket);
+            if (!receiveRDBFromMaster(masterSocket, pending)) {
+                return;
+            }
         } else {
             std::cerr << "Invalid FULLRESYNC response format\n";
         }
@@ -640,70 +531,59 @@ void ReplicaConnection::processPSyncResponse(int masterSocket) {
     }
     
     masterLink = true;
-    masterLastIoTime = time(NULL);
+    masterLastIoMs = ServerClock::monotonicMs();
     
-    processMasterStream(masterSocket);
+    processMasterStream(masterSocket, pending);
 }
 
-void ReplicaConnection::receiveRDBFromMaster(int masterSocket) {
+// pending holds bytes already read past the PSYNC reply; on return it holds what follows the RDB
+bool ReplicaConnection::receiveRDBFromMaster(int masterSocket, std::string& pending) {
     std::cout << "Receiving RDB file from master..." << std::endl;
     
     char buffer[1024];
-    memset(buffer, 0, sizeof(buffer));
     
-    ssize_t bytesRead = recv(masterSocket, buffer, sizeof(buffer) - 1, 0);
-    if (bytesRead <= 0) {
-        std::cerr << "Error receiving RDB length from master\n";
-        close(masterSocket);
-        return;
-    }
-    
-    std::string lengthStr(buffer, bytesRead);
-    
-    if (lengthStr[0] != '$') {
-        std::cerr << "Expected bulk string marker, got: " << lengthStr << std::endl;
-        close(masterSocket);
-        return;
+    // read until the whole $<length>\r\n header is buffered
+    while (pending.find("\r\n") == std::string::npos) {
+        ssize_t bytesRead = recv(masterSocket, buffer, sizeof(buffer), 0);
+        if (bytesRead <= 0) {
+            std::cerr << "Error receiving RDB length from master\n";
+            close(masterSocket);
+            return false;
+        }
+        pending.append(buffer, bytesRead);
     }
     
-    size_t crlfPos = lengthStr.find("\r\n");
-    if (crlfPos == std::string::npos) {
-        std::cerr << "Invalid RESP format for RDB length\n";
+    if (pending[0] != '$') {
+        std::cerr << "Expected bulk string marker, got: " << pending << std::endl;
         close(masterSocket);
-        return;
+        return false;
     }
     
-    size_t rdbLength = std::stoll(lengthStr.substr(1, crlfPos - 1));
+    size_t crlfPos = pending.find("\r\n");
+    size_t rdbLength = std::stoll(pending.substr(1, crlfPos - 1));
     std::cout << "RDB file size: " << rdbLength << " bytes" << std::endl;
     
-    std::string rdbData;
-    rdbData.reserve(rdbLength);
-    
-    // Skip any data already read that's part of the RDB file
-    if (crlfPos + 2 < bytesRead) {
-        rdbData.append(lengthStr.substr(crlfPos + 2));
-    }
-    
-    // Read the rest of the RDB file
-    while (rdbData.size() < rdbLength) {
-        memset(buffer, 0, sizeof(buffer));
-        bytesRead = recv(masterSocket, buffer, std::min(sizeof(buffer) - 1, 
-                                                       rdbLength - rdbData.size()), 0);
+    // payload plus the CRLF the master appends after it
+    size_t needed = crlfPos + 2 + rdbLength + 2;
+    while (pending.size() < needed) {
+        ssize_t bytesRead = recv(masterSocket, buffer, sizeof(buffer), 0);
         if (bytesRead <= 0) {
             std::cerr << "Error receiving RDB content from master\n";
             close(masterSocket);
-            return;
+            return false;
         }
         
-        rdbData.append(buffer, bytesRead);
-        std::cout << "Received " << rdbData.size() << " of " << rdbLength 
-                << " bytes (" << (rdbData.size() * 100 / rdbLength) << "%)\r" << std::flush;
+        pending.append(buffer, bytesRead);
     }
     
-    std::cout << std::endl << "RDB file received completely." << std::endl;
+    std::string rdbData = pending.substr(crlfPos + 2, rdbLength);
+    pending.erase(0, needed);
+    
+    std::cout << "RDB file received completely." << std::endl;
     
     // Load the RDB file into our database
     loadRDBData(rdbData);
+    return true;
 }
 
 // Load RDB data into database
@@ -737,16 +617,40 @@ void ReplicaConnection::loadRDBData(const std::string& rdbData) {
     }
 }
 
-void ReplicaConnection::processMasterStream(int masterSocket) {
+// pending holds stream bytes that arrived together with the sync reply
+void ReplicaConnection::processMasterStream(int masterSocket, std::string pending) {
     std::cout << "Processing command stream from master..." << std::endl;
     
     // Buffer for accumulating RESP commands
-    std::string buffer;
-    char tempBuffer[1024];
+    std::string buffer = std::move(pending);
+    char tempBuffer[16384];
+    
+    RESPParser parser;  // lives across recvs so a split command is resumed, not reparsed
     
     while (!stop) {
-        memset(tempBuffer, 0, sizeof(tempBuffer));
-        ssize_t bytesRead = recv(masterSocket, tempBuffer, sizeof(tempBuffer) - 1, 0);
+        // Process every complete RESP command; the master pipelines its write stream
+        while (true) {
+            size_t commandStart = parser.position();
+            CommandArgs args;
+            ParseStatus status = parser.parse(buffer, args);
+            if (status == ParseStatus::NeedMore) {
+                // Need more data, wait for next recv
+                break;
+            }
+            if (status == ParseStatus::Error) {
+                // Parsing error, discard the command
+                std::cerr << "Error parsing command from master: " << parser.errorMessage() << std::endl;
+                parser.reset();
+                buffer.clear();
+                break;
+            }
+
+            // Successfully parsed a complete command
+            processCommandFromMaster(args, parser.position() - commandStart);
+        }
+        parser.discardConsumed(buffer);
+
+        ssize_t bytesRead = recv(masterSocket, tempBuffer, sizeof(tempBuffer), 0);
         
         if (bytesRead <= 0) {
             std::cerr << "Master connection closed or error\n";
@@ -756,34 +660,8 @@ void ReplicaConnection::processMasterStream(int masterSocket) {
             break;
         }
         
-        masterLastIoTime = time(NULL);
+        masterLastIoMs = ServerClock::monotonicMs();
         buffer.append(tempBuffer, bytesRead);
-        
-        // Process complete RESP commands
-        while (!buffer.empty()) {
-            try {
-                RESPParser parser;
-                RESPElement parsedCommand = parser.parse(buffer);
-                
-                // Successfully parsed a complete command
-                std::string command = parsedCommand.array[0].value;
-                buffer.clear();
-                
-                processCommandFromMaster(command);
-                
-            } catch (const std::exception& e) {
-                std::string error = e.what();
-                if (error.find("Incomplete") != std::string::npos) {
-                    // Need more data, wait for next recv
-                    break;
-                } else {
-                    // Parsing error, discard the command
-                    std::cerr << "Error parsing command from master: " << error << std::endl;
-                    buffer.clear();
-                    break;
-                }
-            }
-        }
     }
 }
 
@@ -860,5 +738,5 @@ std::string ReplicaConnection::generateRunId() {
 
 void ReplicaConnection::updateReplicationStatus(long long newOffset) {
     offset = newOffset;
-    masterLastIoTime = time(NULL);
+    masterLastIoMs = ServerClock::monotonicMs();
 }
\ No newline at end of file
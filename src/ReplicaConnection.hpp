@@ -22,6 +22,10 @@
 #include "DB.hpp"
 #include "resp_parser.hpp"
 #include "handler.hpp"
+#include "EventLoop.hpp"
+#include "reply_builder.hpp"
+#include "command_table.hpp"
+#include "ServerClock.hpp"
 
 class ReplicaConnection {
 private:
@@ -31,8 +35,7 @@ private:
     std::atomic<bool> stop;
     std::thread serverThread;
     std::thread masterConnectionThread;
-    std::mutex clientThreadsMutex;
-    std::vector<std::thread> clientThreads;
+    EventLoop eventLoop;           // owns all client sockets
     Handler handler;
 
     // Replication state
@@ -41,13 +44,10 @@ private:
     std::string replicationId;     // Master's replication ID
     std::string runId;             // Unique ID for this replica
     std::atomic<bool> masterLink;  // If connected to master
-    std::atomic<long long> masterLastIoTime;  // Last interaction time with master
+    std::atomic<long long> masterLastIoMs;  // Last interaction with master (ServerClock::monotonicMs)
     
     // RESP formatting helpers
-    std::string formatRespString(const std::string& str);
-    std::string formatRespError(const std::string& str);
-    std::string formatRespBulkString(const std::string& str);
-    std::string formatRESP(const std::vector<std::string>& args);
+    std::string formatRESP(const CommandArgs& args);
     std::string toUpper(const std::string& str);
 
     // Network helpers
@@ -56,26 +56,26 @@ private:
     int getClientPort(int clientSocket);
     
     // Command processing
-    void processCommand(std::string& commandBuffer, int clientSocket, bool isFromMaster);
-    void processCommandFromMaster(const std::string& cmd);
+    void processCommand(const CommandArgs& args, size_t commandBytes, int clientSocket, bool isFromMaster, ReplyBuilder& reply);
+    void processCommandFromMaster(const CommandArgs& args, size_t commandBytes);
     
     // Replication protocol handlers
-    void handleReplicationCommand(int fd, const std::vector<RESPElement>& args);
-    void handleReplConf(int fd, const std::vector<RESPElement>& args);
-    void handlePSync(int fd, const std::vector<RESPElement>& args);
-    void handleInfo(int fd, const std::vector<RESPElement>& args);
-    void handleWait(int fd, const std::vector<RESPElement>& args);
+    void handleReplicationCommand(int fd, const CommandArgs& args, ReplyBuilder& reply);
+    void handleReplConf(const CommandArgs& args, ReplyBuilder& reply);
+    void handlePSync(int fd, const CommandArgs& args, ReplyBuilder& reply);
+    void handleInfo(const CommandArgs& args, ReplyBuilder& reply);
+    void handleWait(const CommandArgs& args, ReplyBuilder& reply);
     
     // Server and client handling
     void serverLoop();
-    void handleClientConnection(int clientSocket);
+    void handleClientData(Connection& conn);
     
     // Master connection methods
     void connectToMaster();
     void processPSyncResponse(int masterSocket);
-    void receiveRDBFromMaster(int masterSocket);
+    bool receiveRDBFromMaster(int masterSocket, std::string& pending);
     void loadRDBData(const std::string& rdbData);
-    void processMasterStream(int masterSocket);
+    void processMasterStream(int masterSocket, std::string pending);
     
     // Utility methods
     std::string generateRunId();
@@ -84,6 +84,9 @@ public:
     // Constructor and destructor
     ReplicaConnection(int port, std::string replicaOfHost, int replicaOfPort);
     ~ReplicaConnection();
+
+    // block until the client listener shuts down
+    void wait();
     
     // Public interface methods
     void setMaster(const std::string& host, int port);
@@ -4,11 +4,15 @@
 #include <cstring>
 #include <unistd.h>
 #include <iostream>
-#include <thread>
 #include <mutex>
+#include <thread>
+#include <algorithm>
 #include <vector>
 #include <chrono>
 #include <random>
+#include <optional>
+#include <charconv>
+#include <cstdint>
 #include <arpa/inet.h> 
 #include <netinet/in.h>
 #include <sys/socket.h>
@@ -19,152 +23,124 @@
 #include <netdb.h>
 #include "resp_parser.hpp"
 #include "Handler.hpp"
+#include "DB.hpp"
 #include "MasterServer.hpp"
+#include "EventLoop.hpp"
+#include "reply_builder.hpp"
+#include "crlf_scan.hpp"
+#include "command_table.hpp"
+#include "BlockingRegistry.hpp"
+#include "ServerClock.hpp"
 
-#define BUFFER_SIZE 128
+// Before a write runs while over --maxmemory: evict down to the limit, propagating each
+// eviction to replicas as a DEL. False if the command grows memory and room couldn't be made.
+bool makeRoomForWrite(const CommandSpec& cmd, MasterServer* master) {
+    DB& db = DB::getInstance();
+    if (!db.overMemoryLimit()) return true;
 
-void processRequest(int fd, const RESPElement& requestArr, Handler & handler, MasterServer * master) {
-    std::vector<RESPElement> requestArray = requestArr.array;
-    if (requestArray.empty()) return;
-
-    std::string command = requestArray[0].value;
-    
-    // Extract command arguments for replication
-    std::vector<std::string> cmdArgs;
-    for (const auto& elem : requestArray) {
-        cmdArgs.push_back(elem.value);
-    }
-    
-    // Process different Redis commands with appropriate replication
-    if (command == "SET") {
-        handler.handleSet(fd, requestArray);
-        // Propagate write commands to replicas if we're a master
-        master->propagateWrite(cmdArgs);
-    }
-    else if (command == "GET") {  // no propagation for reads
-        handler.handleGet(fd, requestArray);
-    }
-    else if (command == "EXISTS") {
-        handler.handleExists(fd, requestArray);
+    std::vector<std::string> evicted;
+    bool underLimit = db.evictToLimit(evicted);
+    for (const std::string& key : evicted) {
+        master->propagateWrite(CommandArgs{"DEL", key});
     }
-    else if (command == "DEL") {
-        handler.handleDel(fd, requestArray);
-        master->propagateWrite(cmdArgs);
-    }
-    else if (command == "INCR") {
-        handler.handleIncr(fd, requestArray);
-        master->propagateWrite(cmdArgs);
-    }
-    else if (command == "DECR") {
-        handler.handleDecr(fd, requestArray);
-        master->propagateWrite(cmdArgs);
-    }
-    else if (command == "LPUSH") {
-        handler.handleLPush(fd, requestArray);
-        master->propagateWrite(cmdArgs);
-    }
-    else if (command == "RPUSH") {
-        handler.handleRPush(fd, requestArray);
-        master->propagateWrite(cmdArgs);
+    return underLimit || !cmd.hasFlag(CMD_DENYOOM);
+}
+
+void processRequest(Connection& conn, const CommandArgs& args, Handler & handler, MasterServer * master, ReplyBuilder & reply) {
+    if (args.empty()) return;
+
+    const CommandSpec* cmd = lookupCommand(args[0]);
+    if (!cmd) {
+        reply.error("ERR unknown command");
+        return;
     }
-    else if (command == "LRANGE") {
-        handler.handleLRange(fd, requestArray);
+    if (!cmd->arityMatches(args.size())) {
+        replyWrongArity(reply, args[0]);
+        return;
     }
-    else if (command == "HSET") {
-        handler.handleSet(fd, requestArray);
-        master->propagateWrite(cmdArgs);
+
+    if (cmd->hasFlag(CMD_REPLICATION)) {
+        master->handleReplicationCommand(conn, args, reply);
+        return;
     }
-    else if (command == "REPLICA") {  // add replica
-        if (master && requestArray.size() >= 3) {
-            std::string host = requestArray[1].value;
-            int port = std::stoi(requestArray[2].value);
-            master->addReplica(host, port);
-            std::string response = "+OK\r\n";
-            send(fd, response.c_str(), response.length(), 0);
-        } else {
-            std::string response = "-ERR invalid REPLICA command or not a master\r\n";
-            send(fd, response.c_str(), response.length(), 0);
+
+    // a write and its propagation happen under one hold of the gate, so a PSYNC snapshot
+    // sees either both or neither
+    std::shared_lock<std::shared_mutex> gate;
+    if (cmd->hasFlag(CMD_WRITE)) {
+        gate = master->lockWrites();
+        if (!makeRoomForWrite(*cmd, master)) {
+            reply.error("OOM command not allowed when used memory > 'maxmemory'.");
+            return;
         }
     }
-    else if (command == "REPLICAS") {
-        std::string info = "Connected replicas: " + std::to_string(master->getConnectedReplicaCount()) + "\n";
-        info += master->getMasterInfo() + "\n";
-        
-        auto replicaList = master->getReplicaList();
-        for (const auto& replica : replicaList) {
-            info += "- " + replica.first + ":" + std::to_string(replica.second) + "\n";
+
+    CommandContext ctx{args, reply, handler, master, &conn};
+    cmd->proc(ctx);
+    if (cmd->hasFlag(CMD_WRITE)) {
+        if (!cmd->hasFlag(CMD_BLOCKING)) {  // blocking commands propagate their rewritten form themselves
+            master->propagateWrite(args);  // no propagation for reads
         }
-        
-        std::string response = "$" + std::to_string(info.length()) + "\r\n" + info + "\r\n";
-        send(fd, response.c_str(), response.length(), 0);
-    }
-    else if (command == "INFO" || command == "REPLCONF" || command == "PSYNC" || command == "WAIT") {
-        master->handleReplicationCommand(fd, requestArray);
-    }
-    else {
-        std::string response = "-ERR unknown command\r\n";
-        send(fd, response.c_str(), response.length(), 0);
+        // clients blocked on keys this command pushed to get their elements after the push
+        // has gone out, so replicas see the push before the pops it fed
+        BlockingRegistry::getInstance().serveReadyKeys(master);
     }
 }
 
-void handle_requests(int fd)
+// Called by the event loop after each read cycle with everything received so far.
+// Drains every complete (pipelined) command; replies are queued on the connection and the
+// loop flushes them with one send once we return. The connection's parser keeps its place
+// in an incomplete trailing command, so the next read continues instead of reparsing.
+void handle_requests(Connection& conn, Handler& handler, MasterServer * master)
 {
-  Handler handler;
-  RESPParser parser;
-  std::string buffer;  // dynamic buffer so can receive longer messages
-  char temp[BUFFER_SIZE]; // temporary buffer for immediate receive with recv
-  MasterServer * master;
-
-  while (true)
-  {
-    memset(temp, 0, sizeof(temp));
-    int bytes_received = recv(fd, temp, sizeof(temp)-1,0);
+  RESPParser& parser = conn.parser;
+  std::string& buffer = conn.readBuffer;
+  ReplyBuilder reply(conn.writeBuffer);
+  CommandArgs args;  // reused across the batch; holds views only, never copies
 
-    if (bytes_received <= 0)
-    {
-      std::cerr << "Client disconnected or error occurred.\n";
-      break;
+  while (!conn.blocked) {  // a blocked client's later commands wait until it is released
+    ParseStatus status = parser.parse(buffer, args);
+    if (status == ParseStatus::NeedMore) {
+        break;  // wait for rest of msg
+    }
+    if (status == ParseStatus::Error) {
+        std::cerr << "RESP Parsing Error: " << parser.errorMessage() << "\n";
+        reply.error("ERR invalid request");
+        parser.reset();
+        buffer.clear();  // move on since parser will never decipher it
+        return;
     }
-    
-    buffer.append(temp, bytes_received);
-
     try {
-          RESPElement request = parser.parse(buffer);
-          if (request.type == RESPType::Array && !request.array.empty()) {
-              std::string command = request.array[0].value; // First element is the command
-              processRequest(fd, request, handler, master);
-              buffer.clear();
-          }
-        } 
-      catch (const std::exception& e) {
-        std::string errorMessage = e.what();
-        if (errorMessage.find("Incomplete") != std::string::npos) {
-            continue;  // wait for rest of msg
-        }
-        else {
-            std::cerr << "RESP Parsing Error: " << errorMessage << "\n";
-            send(fd, "-ERR invalid request\r\n", 22, 0);
-            buffer.clear();  // move on since parser will never decipher it
-        }
-      }
+        processRequest(conn, args, handler, master, reply);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error processing request: " << e.what() << "\n";
+        reply.error("ERR invalid request");
+    }
   }
+  parser.discardConsumed(buffer);  // keep only the partial trailing command
 }
 
-int masterServerLoop(int port) {
-    std::cout << std::unitbuf;
-    std::cerr << std::unitbuf;
-
+// create a bound, listening TCP socket. with reusePort, several sockets can share the port
+// and the kernel load-balances incoming connections between them
+int createListenSocket(int port, bool reusePort) {
     int server_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (server_fd < 0) {
         std::cerr << "Failed to create server socket\n";
-        return 1;
+        return -1;
     }
 
     // reuse address so we don't run into 'Address already in use' errors
     int reuse = 1;
     if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0) {
         std::cerr << "setsockopt failed\n";
-        return 1;
+        close(server_fd);
+        return -1;
+    }
+    if (reusePort && setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) < 0) {
+        std::cerr << "setsockopt SO_REUSEPORT failed\n";
+        close(server_fd);
+        return -1;
     }
 
     struct sockaddr_in server_addr;
@@ -174,48 +150,124 @@ int masterServerLoop(int port) {
 
     if (bind(server_fd, (struct sockaddr *) &server_addr, sizeof(server_addr)) != 0) {
         std::cerr << "Failed to bind to port " << port << "\n";
-        return 1;
+        close(server_fd);
+        return -1;
     }
 
-    int connection_backlog = 5;
+    int connection_backlog = SOMAXCONN;  // bursts of thousands of clients connect at once
     if (listen(server_fd, connection_backlog) != 0) {
         std::cerr << "listen failed\n";
-        return 1;
+        close(server_fd);
+        return -1;
+    }
+    return server_fd;
+}
+
+// one reactor per thread; it owns every client socket accepted on listenFd.
+// Loop 0 also runs the keyspace housekeeping tick.
+void runEventLoop(int listenFd, MasterServer * master, int core, bool runCron) {
+    if (core >= 0 && !pinThreadToCore(core)) {
+        std::cerr << "Failed to pin event loop thread to core " << core << "\n";
+    }
+
+    Handler handler;
+    EventLoop loop(
+        [&handler, master](Connection& conn) { handle_requests(conn, handler, master); },
+        nullptr,  // no per-accept work
+        [master](Connection& conn) {
+            BlockingRegistry::getInstance().clientClosed(conn);
+            master->replicaClosed(conn);
+        });
+    if (runCron) {
+        loop.runEvery(std::chrono::milliseconds(DB::CRON_INTERVAL_MS), [] { DB::getInstance().cron(); });
+    }
+    if (loop.addListener(listenFd)) {
+        loop.run();
     }
+    close(listenFd);
+}
 
-    struct sockaddr_in client_addr;
-    int client_addr_len = sizeof(client_addr);
-    std::cout << "Master server waiting for clients to connect on port " << port << "...\n";
+// ioThreads > 1 opens one SO_REUSEPORT listener per thread, so there is no shared accept queue
+// and no cross-thread hand-off: a connection lives on the loop whose socket accepted it
+int masterServerLoop(int port, MasterServer * master, int ioThreads, bool pinThreads) {
+    std::cout << std::unitbuf;
+    std::cerr << std::unitbuf;
 
-    while (true) {  // keep on creating thread per client that forms conn
-        int client_fd = accept(server_fd, (struct sockaddr *) &client_addr, (socklen_t *) &client_addr_len);
-        if (client_fd < 0) {
-            std::cerr << "TCP Handshake failed\n";
-            continue; 
+    if (ioThreads < 1) ioThreads = 1;
+    std::vector<int> listenFds;
+    for (int i = 0; i < ioThreads; i++) {
+        int fd = createListenSocket(port, ioThreads > 1);
+        if (fd < 0) {
+            for (int opened : listenFds) close(opened);
+            return 1;
         }
-        
-        char client_ip[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &(client_addr.sin_addr), client_ip, INET_ADDRSTRLEN);
-        std::cout << "Client connected from " << client_ip << ":" << ntohs(client_addr.sin_port) << "\n";
+        listenFds.push_back(fd);
+    }
 
-        std::thread client_thread(handle_requests, client_fd);
-        client_thread.detach();  // let it run independently
+    std::cout << "Master server waiting for clients to connect on port " << port
+              << " with " << ioThreads << " event loop thread(s)...\n";
+    std::cout << "RESP scanner: " << crScanKernel() << "\n";
+
+    unsigned int numCores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> loopThreads;
+    for (int i = 1; i < ioThreads; i++) {
+        int core = pinThreads ? static_cast<int>(i % numCores) : -1;
+        loopThreads.emplace_back(runEventLoop, listenFds[i], master, core, false);
+    }
+    runEventLoop(listenFds[0], master, pinThreads ? 0 : -1, true);  // main thread is loop 0
+
+    for (auto& thread : loopThreads) {
+        thread.join();
     }
-    close(server_fd);
     return 0;
 }
 
+// "100mb", "2gb", "4096", like maxmemory in redis.conf; nullopt if malformed
+std::optional<size_t> parseMemorySize(std::string_view text) {
+    size_t value = 0;
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc() || end == text.data()) return std::nullopt;
+
+    std::string unit(end, text.data() + text.size());
+    std::transform(unit.begin(), unit.end(), unit.begin(), ::tolower);
+    size_t multiplier = 1;  // as in redis.conf: 1k is 1000 bytes, 1kb is 1024
+    if (unit == "k") multiplier = 1000;
+    else if (unit == "kb") multiplier = 1024;
+    else if (unit == "m") multiplier = 1000 * 1000;
+    else if (unit == "mb") multiplier = 1024 * 1024;
+    else if (unit == "g") multiplier = 1000 * 1000 * 1000;
+    else if (unit == "gb") multiplier = 1024 * 1024 * 1024;
+    else if (!unit.empty() && unit != "b") return std::nullopt;
+    if (value > SIZE_MAX / multiplier) return std::nullopt;  // e.g. 99999999999gb would wrap
+    return value * multiplier;
+}
+
 int main(int argc, char* argv[]) {
     bool isReplica = false;
     std::string replicaOfHost;
     int replicaOfPort = 0;
     int port = 6379; // Default port if not provided.
+    int ioThreads = 1;
+    bool pinThreads = false;
+    int clockHz = ServerClock::DEFAULT_HZ;
+    size_t maxMemory = 0;
+    DB::EvictionPolicy evictionPolicy = DB::EvictionPolicy::NoEviction;
+    size_t hashMaxEntries = HashValue::DEFAULT_MAX_COMPACT_ENTRIES;
+    size_t hashMaxValue = HashValue::DEFAULT_MAX_COMPACT_VALUE;
+    size_t zsetMaxEntries = SortedSet::DEFAULT_MAX_COMPACT_ENTRIES;
+    size_t zsetMaxValue = SortedSet::DEFAULT_MAX_COMPACT_VALUE;
     std::vector<std::pair<std::string, int>> replicaPorts; // List of replica host:port pairs
     MasterServer * master;
     // Simple command-line argument parsing.
     // If "--replicaof <host> <port>" is provided, we run as a replica.
     // The "--port" flag sets the local listening port.
     // New: "--replica <host> <port>" can be used multiple times to add initial replicas
+    // "--io-threads <n>" runs n event loops on SO_REUSEPORT listeners, "--pin-io-threads" pins them to cores
+    // "--shards <n>" sets how many lock-striped shards the keyspace is split into
+    // "--clock-hz <n>" sets how many times a second the cached server clock is refreshed
+    // "--maxmemory <bytes>" (k/kb/m/mb/g/gb suffixes as in redis.conf) and "--maxmemory-policy <policy>" bound the keyspace
+    // "--hash-max-listpack-entries <n>" and "--hash-max-listpack-value <bytes>" cap when hashes stay compact
+    // "--zset-max-listpack-entries <n>" and "--zset-max-listpack-value <bytes>" do the same for sorted sets
     for (int i = 1; i < argc; ++i) {
         std::string arg(argv[i]);
         if (arg == "--replicaof" && i + 2 < argc) {
@@ -226,6 +278,45 @@ int main(int argc, char* argv[]) {
         } else if (arg == "--port" && i + 1 < argc) {
             port = std::stoi(argv[i + 1]);
             ++i;
+        } else if (arg == "--io-threads" && i + 1 < argc) {
+            ioThreads = std::stoi(argv[i + 1]);
+            ++i;
+        } else if (arg == "--pin-io-threads") {
+            pinThreads = true;
+        } else if (arg == "--shards" && i + 1 < argc) {
+            DB::setShardCount(std::stoul(argv[i + 1]));  // before anything touches the DB
+            ++i;
+        } else if (arg == "--clock-hz" && i + 1 < argc) {
+            clockHz = std::stoi(argv[i + 1]);
+            ++i;
+        } else if (arg == "--maxmemory" && i + 1 < argc) {
+            std::optional<size_t> bytes = parseMemorySize(argv[i + 1]);
+            if (!bytes) {
+                std::cerr << "Invalid --maxmemory: " << argv[i + 1] << std::endl;
+                return 1;
+            }
+            maxMemory = *bytes;
+            ++i;
+        } else if (arg == "--maxmemory-policy" && i + 1 < argc) {
+            std::optional<DB::EvictionPolicy> policy = DB::parseEvictionPolicy(argv[i + 1]);
+            if (!policy) {
+                std::cerr << "Unknown --maxmemory-policy: " << argv[i + 1] << std::endl;
+                return 1;
+            }
+            evictionPolicy = *policy;
+            ++i;
+        } else if (arg == "--hash-max-listpack-entries" && i + 1 < argc) {
+            hashMaxEntries = std::stoul(argv[i + 1]);
+            ++i;
+        } else if (arg == "--hash-max-listpack-value" && i + 1 < argc) {
+            hashMaxValue = std::stoul(argv[i + 1]);
+            ++i;
+        } else if (arg == "--zset-max-listpack-entries" && i + 1 < argc) {
+            zsetMaxEntries = std::stoul(argv[i + 1]);
+            ++i;
+        } else if (arg == "--zset-max-listpack-value" && i + 1 < argc) {
+            zsetMaxValue = std::stoul(argv[i + 1]);
+            ++i;
         } else if (arg == "--replica" && i + 2 < argc) {
             std::string host = argv[i + 1];
             int replicaPort = std::stoi(argv[i + 2]);
@@ -236,12 +327,17 @@ int main(int argc, char* argv[]) {
             return 1;
         }
     }
+    ServerClock::start(clockHz);
+    DB::setMaxMemory(maxMemory, evictionPolicy);
+    HashValue::setCompactLimits(hashMaxEntries, hashMaxValue);
+    SortedSet::setCompactLimits(zsetMaxEntries, zsetMaxValue);
     
     if (isReplica) {
         std::cout << "Starting replica instance on port " << port << std::endl;
         std::cout << "Replica connecting to master at " << replicaOfHost 
                   << ":" << replicaOfPort << std::endl;
         auto replica = new ReplicaConnection(port, replicaOfHost, replicaOfPort); 
+        replica->wait();  // serve clients until the listener stops
     } else {
         std::cout << "Starting master server instance on port " << port << std::endl;
         
@@ -257,7 +353,7 @@ int main(int argc, char* argv[]) {
         std::cout << "Connected replicas: " << master->getConnectedReplicaCount() << std::endl;
         
         // Run the server loop
-        masterServerLoop(port);
+        masterServerLoop(port, master, ioThreads, pinThreads);
         
         // Clean up
         delete master;
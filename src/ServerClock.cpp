@@ -0,0 +1,40 @@
+#include "ServerClock.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+long long ServerClock::readWallMs() {
+    auto now = std::chrono::system_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+}
+
+long long ServerClock::readMonotonicMs() {
+    auto now = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+}
+
+void ServerClock::tick() {
+    wallMs_.store(readWallMs(), std::memory_order_relaxed);
+    monotonicMs_.store(readMonotonicMs(), std::memory_order_relaxed);
+}
+
+void ServerClock::start(int hz) {
+    hz_.store(std::clamp(hz, 1, MAX_HZ), std::memory_order_relaxed);
+    tick();
+
+    // first call only: keep the cache fresh until exit, when the jthread is asked to stop
+    // and joined (the wait wakes on stop, so that is immediate)
+    static std::jthread ticker([](std::stop_token stop) {
+        std::mutex mutex;
+        std::condition_variable_any wake;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stop.stop_requested()) {
+            tick();
+            auto period = std::chrono::microseconds(1000000 / hz_.load(std::memory_order_relaxed));
+            wake.wait_for(lock, stop, period, [] { return false; });
+        }
+    });
+    (void)ticker;
+}
@@ -0,0 +1,41 @@
+#ifndef SERVER_CLOCK_HPP
+#define SERVER_CLOCK_HPP
+
+#include <atomic>
+
+// Process-wide cached clock. A ticker thread refreshes a wall-clock and a monotonic
+// millisecond timestamp hz times a second, so hot paths (expiry checks on every key
+// access, replication bookkeeping) read one relaxed atomic instead of calling into the
+// kernel. Readings are at most one tick stale. Until start() is called, reads fall
+// through to the real clocks, so tools that link the DB without a server still work.
+class ServerClock {
+public:
+    static constexpr int DEFAULT_HZ = 1000;
+    static constexpr int MAX_HZ = 1000;  // the cache holds whole milliseconds
+
+    // Launch the ticker (once; later calls only change the rate). hz is clamped to 1..MAX_HZ.
+    static void start(int hz = DEFAULT_HZ);
+
+    // unix time in ms
+    static long long nowMs() {
+        long long cached = wallMs_.load(std::memory_order_relaxed);
+        return cached ? cached : readWallMs();
+    }
+
+    // ms on a clock that never jumps backwards; only differences are meaningful
+    static long long monotonicMs() {
+        long long cached = monotonicMs_.load(std::memory_order_relaxed);
+        return cached ? cached : readMonotonicMs();
+    }
+
+private:
+    static inline std::atomic<long long> wallMs_{0};       // 0 until the ticker runs
+    static inline std::atomic<long long> monotonicMs_{0};
+    static inline std::atomic<int> hz_{DEFAULT_HZ};
+
+    static long long readWallMs();
+    static long long readMonotonicMs();
+    static void tick();
+};
+
+#endif // SERVER_CLOCK_HPP
@@ -0,0 +1,152 @@
+#include "SlabAllocator.hpp"
+#include <mutex>
+
+// One per size class. Guards the class's shared free list and the unused tail of its
+// newest slab; threads only come here to refill or trim their caches, a batch at a time.
+struct SlabAllocator::Central {
+    std::mutex mutex;
+    FreeChunk* free = nullptr;
+    size_t freeCount = 0;
+    char* carve = nullptr;      // next never-used chunk of the newest slab
+    char* carveEnd = nullptr;
+    size_t reservedBytes = 0;
+};
+
+namespace {
+    // Trivially destructible, so still readable while thread_locals are torn down: frees
+    // that arrive after the cache is gone (nodes freed by static destructors at exit,
+    // say) go straight to the central lists.
+    enum class CacheState : uint8_t { Unused, Alive, Dead };
+    thread_local CacheState cacheState = CacheState::Unused;
+}
+
+struct SlabAllocator::ThreadCache {
+    FreeChunk* head[NUM_CLASSES] = {};
+    size_t count[NUM_CLASSES] = {};
+
+    ThreadCache() { cacheState = CacheState::Alive; }
+
+    // a finished thread's chunks go back for others to use
+    ~ThreadCache() {
+        cacheState = CacheState::Dead;
+        for (size_t cls = 0; cls < NUM_CLASSES; cls++) {
+            if (!head[cls]) continue;
+            FreeChunk* tail = head[cls];
+            while (tail->next) tail = tail->next;
+            release(cls, head[cls], tail, count[cls]);
+        }
+    }
+};
+
+SlabAllocator::Central& SlabAllocator::central(size_t cls) {
+    // never freed: chunks may still be handed back during static destruction
+    static Central* centrals = new Central[NUM_CLASSES];
+    return centrals[cls];
+}
+
+SlabAllocator::ThreadCache* SlabAllocator::threadCache() {
+    if (cacheState == CacheState::Dead) return nullptr;
+    thread_local ThreadCache cache;
+    return &cache;
+}
+
+size_t SlabAllocator::chunkSize(size_t bytes) {
+    return bytes > MAX_SIZE ? bytes : CLASS_SIZES[classOf(bytes)];
+}
+
+// count chunks linked through next, from the central free list first, then carved fresh
+SlabAllocator::FreeChunk* SlabAllocator::refill(size_t cls, size_t count) {
+    Central& c = central(cls);
+    size_t size = CLASS_SIZES[cls];
+    std::lock_guard<std::mutex> lock(c.mutex);
+
+    FreeChunk* head = nullptr;
+    for (; count > 0 && c.free; count--) {
+        FreeChunk* chunk = c.free;
+        c.free = chunk->next;
+        c.freeCount--;
+        chunk->next = head;
+        head = chunk;
+    }
+    for (; count > 0; count--) {
+        if (c.carve == c.carveEnd) {
+            c.carve = static_cast<char*>(::operator new(SLAB_BYTES));
+            c.carveEnd = c.carve + SLAB_BYTES / size * size;
+            c.reservedBytes += SLAB_BYTES;
+        }
+        FreeChunk* chunk = reinterpret_cast<FreeChunk*>(c.carve);
+        c.carve += size;
+        chunk->next = head;
+        head = chunk;
+    }
+    return head;
+}
+
+void SlabAllocator::release(size_t cls, FreeChunk* head, FreeChunk* tail, size_t count) {
+    Central& c = central(cls);
+    std::lock_guard<std::mutex> lock(c.mutex);
+    tail->next = c.free;
+    c.free = head;
+    c.freeCount += count;
+}
+
+void* SlabAllocator::allocate(size_t bytes) {
+    if (bytes > MAX_SIZE) {
+        largeBytes_.fetch_add(bytes, std::memory_order_relaxed);
+        return ::operator new(bytes);
+    }
+    size_t cls = classOf(bytes);
+    ThreadCache* cache = threadCache();
+    if (!cache) return refill(cls, 1);
+
+    FreeChunk* chunk = cache->head[cls];
+    if (!chunk) {
+        size_t batch = batchSize(cls);
+        chunk = refill(cls, batch);
+        cache->count[cls] = batch;
+    }
+    cache->head[cls] = chunk->next;
+    cache->count[cls]--;
+    return chunk;
+}
+
+void SlabAllocator::deallocate(void* ptr, size_t bytes) {
+    if (!ptr) return;
+    if (bytes > MAX_SIZE) {
+        largeBytes_.fetch_sub(bytes, std::memory_order_relaxed);
+        ::operator delete(ptr);
+        return;
+    }
+    size_t cls = classOf(bytes);
+    FreeChunk* chunk = static_cast<FreeChunk*>(ptr);
+    ThreadCache* cache = threadCache();
+    if (!cache) {
+        chunk->next = nullptr;
+        release(cls, chunk, chunk, 1);
+        return;
+    }
+
+    chunk->next = cache->head[cls];
+    cache->head[cls] = chunk;
+    // a thread that frees more than it allocates (the one reclaiming retired nodes, say)
+    // hands a batch back once it holds two
+    size_t batch = batchSize(cls);
+    if (++cache->count[cls] <= 2 * batch) return;
+    FreeChunk* tail = chunk;
+    for (size_t i = 1; i < batch; i++) tail = tail->next;
+    cache->head[cls] = tail->next;
+    cache->count[cls] -= batch;
+    release(cls, chunk, tail, batch);
+}
+
+SlabAllocator::Stats SlabAllocator::stats() {
+    Stats stats{};
+    for (size_t cls = 0; cls < NUM_CLASSES; cls++) {
+        Central& c = central(cls);
+        std::lock_guard<std::mutex> lock(c.mutex);
+        stats.reserved += c.reservedBytes;
+        stats.centralFree += c.freeCount * CLASS_SIZES[cls] + (c.carveEnd - c.carve);
+    }
+    stats.large = largeBytes_.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,98 @@
+#ifndef SLAB_ALLOCATOR_HPP
+#define SLAB_ALLOCATOR_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+
+// Size-class allocator for the keyspace's small objects: nodes, long keys and raw string
+// values. Memory comes from the OS in SLAB_BYTES slabs, each carved into equal chunks of
+// one class. Every thread keeps a free list per class and trades chunks with the class's
+// central list in batches, so allocating and freeing normally take no lock and never
+// touch another thread's cache lines. Chunks are recycled within their class and not
+// handed back to the OS: under SET/DEL churn the same chunks go round and round instead
+// of fragmenting the general heap. Requests above MAX_SIZE go to operator new.
+class SlabAllocator {
+public:
+    static constexpr size_t MAX_SIZE = 1024;
+    static constexpr size_t SLAB_BYTES = 64 * 1024;
+
+    static void* allocate(size_t bytes);
+    // bytes must be what was asked of allocate() (or anything in the same class)
+    static void deallocate(void* ptr, size_t bytes);
+
+    // what allocate(bytes) really sets aside
+    static size_t chunkSize(size_t bytes);
+
+    struct Stats {
+        size_t reserved;     // slab bytes taken from the OS
+        size_t centralFree;  // free chunk bytes on the central lists
+        size_t large;        // bytes passed through to operator new, still live
+    };
+    static Stats stats();
+
+private:
+    static constexpr std::array<uint16_t, 20> CLASS_SIZES = {
+        16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512, 640, 768, 896, 1024,
+    };
+    static constexpr size_t NUM_CLASSES = CLASS_SIZES.size();
+
+    // class index for sizes in 16-byte steps: CLASS_FOR_STEP[(bytes + 15) / 16]
+    static constexpr std::array<uint8_t, MAX_SIZE / 16 + 1> CLASS_FOR_STEP = [] {
+        std::array<uint8_t, MAX_SIZE / 16 + 1> table{};
+        size_t cls = 0;
+        for (size_t step = 0; step < table.size(); step++) {
+            while (CLASS_SIZES[cls] < step * 16) cls++;
+            table[step] = static_cast<uint8_t>(cls);
+        }
+        return table;
+    }();
+
+    static size_t classOf(size_t bytes) { return CLASS_FOR_STEP[(bytes + 15) / 16]; }
+    // chunks moved between a thread cache and the central list at once
+    static size_t batchSize(size_t cls) { return std::max<size_t>(8, 8192 / CLASS_SIZES[cls]); }
+
+    struct FreeChunk {
+        FreeChunk* next;
+    };
+    struct ThreadCache;
+    struct Central;
+
+    static Central& central(size_t cls);
+    static ThreadCache* threadCache();  // null once the thread's cache is torn down
+    static FreeChunk* refill(size_t cls, size_t count);
+    static void release(size_t cls, FreeChunk* head, FreeChunk* tail, size_t count);
+
+    static inline std::atomic<size_t> largeBytes_{0};
+};
+
+// std-style allocator over SlabAllocator, for containers and strings in the keyspace
+template <typename T>
+struct SlabStlAllocator {
+    using value_type = T;
+
+    SlabStlAllocator() noexcept = default;
+    template <typename U>
+    SlabStlAllocator(const SlabStlAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) { return static_cast<T*>(SlabAllocator::allocate(n * sizeof(T))); }
+    void deallocate(T* ptr, size_t n) noexcept { SlabAllocator::deallocate(ptr, n * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const SlabStlAllocator<U>&) const noexcept { return true; }
+};
+
+using SlabString = std::basic_string<char, std::char_traits<char>, SlabStlAllocator<char>>;
+
+// heap bytes behind s: none while it fits in the small-string buffer
+inline size_t stringHeapBytes(const SlabString& s) {
+    const char* inlineBuffer = reinterpret_cast<const char*>(&s);
+    bool inlined = s.data() >= inlineBuffer && s.data() < inlineBuffer + sizeof(s);
+    return inlined ? 0 : SlabAllocator::chunkSize(s.capacity() + 1);
+}
+
+#endif // SLAB_ALLOCATOR_HPP
@@ -0,0 +1,352 @@
+#include "SortedSet.hpp"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <random>
+#include <utility>
+
+void SortedSet::setCompactLimits(size_t maxEntries, size_t maxValue) {
+    maxCompactEntries_ = maxEntries;
+    maxCompactValue_ = maxValue;
+}
+
+SortedSet::SortedSet(SortedSet&& other) noexcept
+    : data_(other.data_), used_(other.used_), capacity_(other.capacity_), count_(other.count_),
+      list_(std::move(other.list_)) {
+    other.data_ = nullptr;
+    other.used_ = other.capacity_ = other.count_ = 0;
+}
+
+SortedSet& SortedSet::operator=(SortedSet&& other) noexcept {
+    SortedSet taken(std::move(other));  // our old contents leave with it
+    std::swap(data_, taken.data_);
+    std::swap(used_, taken.used_);
+    std::swap(capacity_, taken.capacity_);
+    std::swap(count_, taken.count_);
+    std::swap(list_, taken.list_);
+    return *this;
+}
+
+SortedSet::~SortedSet() {
+    freeCompact();
+    if (list_) destroySkipList(*list_);
+}
+
+size_t SortedSet::bytes() const {
+    if (!list_) return capacity_;
+    size_t buckets = list_->index.bucket_count() * sizeof(void*);
+    return sizeof(SkipList) + list_->nodeBytes + SlabAllocator::chunkSize(buckets) +
+           list_->length * SlabAllocator::chunkSize(INDEX_NODE_BYTES);
+}
+
+// ---- compact encoding ----
+
+void SortedSet::writeEntry(char* pos, std::string_view member, double score) {
+    uint32_t length = static_cast<uint32_t>(member.size());
+    if (length < LONG_LENGTH) {
+        *pos++ = static_cast<char>(length);
+    } else {
+        *pos++ = static_cast<char>(LONG_LENGTH);
+        std::memcpy(pos, &length, sizeof(length));
+        pos += sizeof(length);
+    }
+    std::memcpy(pos, member.data(), length);
+    std::memcpy(pos + length, &score, sizeof(score));
+}
+
+std::string_view SortedSet::readMember(const char* pos) {
+    uint8_t first = static_cast<uint8_t>(*pos);
+    if (first != LONG_LENGTH) return {pos + 1, first};
+    uint32_t length;
+    std::memcpy(&length, pos + 1, sizeof(length));
+    return {pos + 1 + sizeof(length), length};
+}
+
+double SortedSet::readScore(std::string_view member) {
+    double score;
+    std::memcpy(&score, member.data() + member.size(), sizeof(score));
+    return score;
+}
+
+uint32_t SortedSet::locate(std::string_view member, size_t* index) const {
+    size_t i = 0;
+    for (const char* pos = data_; pos < data_ + used_; i++) {
+        std::string_view current = readMember(pos);
+        if (current == member) {
+            if (index) *index = i;
+            return static_cast<uint32_t>(pos - data_);
+        }
+        pos = current.data() + current.size() + sizeof(double);
+    }
+    return used_;
+}
+
+// member must be absent
+void SortedSet::insertCompact(std::string_view member, double score) {
+    size_t needed = entrySize(member.size());
+    reserve(used_ + needed);
+    // first entry that sorts after the new one
+    char* pos = data_;
+    while (pos < data_ + used_) {
+        std::string_view current = readMember(pos);
+        if (before(score, member, readScore(current), current)) break;
+        pos = const_cast<char*>(current.data()) + current.size() + sizeof(double);
+    }
+    std::memmove(pos + needed, pos, data_ + used_ - pos);
+    writeEntry(pos, member, score);
+    used_ += static_cast<uint32_t>(needed);
+    count_++;
+}
+
+void SortedSet::eraseCompactAt(uint32_t offset) {
+    size_t bytes = entrySize(readMember(data_ + offset).size());
+    std::memmove(data_ + offset, data_ + offset + bytes, used_ - offset - bytes);
+    used_ -= static_cast<uint32_t>(bytes);
+    count_--;
+}
+
+void SortedSet::reserve(size_t needed) {
+    if (needed <= capacity_) return;
+    size_t capacity = SlabAllocator::chunkSize(std::max<size_t>({needed, 2 * static_cast<size_t>(capacity_), 64}));
+    char* data = static_cast<char*>(SlabAllocator::allocate(capacity));
+    if (used_) std::memcpy(data, data_, used_);
+    SlabAllocator::deallocate(data_, capacity_);
+    data_ = data;
+    capacity_ = static_cast<uint32_t>(capacity);
+}
+
+void SortedSet::convertToSkipList() {
+    auto list = std::make_unique<SkipList>();
+    list->header = createNode(*list, MAX_LEVEL, 0, {});
+    list->index.reserve(count_ + 1);
+    list_ = std::move(list);
+    for (const char* pos = data_; pos < data_ + used_;) {
+        std::string_view member = readMember(pos);
+        double score = readScore(member);
+        pos = member.data() + member.size() + sizeof(double);
+        insertNode(score, member);
+    }
+    freeCompact();
+}
+
+void SortedSet::freeCompact() {
+    SlabAllocator::deallocate(data_, capacity_);
+    data_ = nullptr;
+    used_ = capacity_ = count_ = 0;
+}
+
+// ---- skiplist encoding ----
+
+SortedSet::Node* SortedSet::createNode(SkipList& list, int levelCount, double score, std::string_view member) {
+    size_t bytes = Node::bytesFor(levelCount, member.size());
+    void* memory = SlabAllocator::allocate(bytes);
+    Node* node = new (memory) Node{score, nullptr, static_cast<uint32_t>(member.size()), static_cast<uint32_t>(levelCount)};
+    for (int i = 0; i < levelCount; i++) node->levels()[i] = Level{nullptr, 0};
+    if (!member.empty()) std::memcpy(node->levels() + levelCount, member.data(), member.size());
+    list.nodeBytes += SlabAllocator::chunkSize(bytes);
+    return node;
+}
+
+void SortedSet::destroyNode(SkipList& list, Node* node) {
+    size_t bytes = Node::bytesFor(node->levelCount, node->memberLength);
+    list.nodeBytes -= SlabAllocator::chunkSize(bytes);
+    SlabAllocator::deallocate(node, bytes);
+}
+
+void SortedSet::destroySkipList(SkipList& list) {
+    Node* node = list.header->levels()[0].forward;
+    while (node) {
+        Node* next = node->levels()[0].forward;
+        destroyNode(list, node);
+        node = next;
+    }
+    destroyNode(list, list.header);
+}
+
+int SortedSet::randomLevel() {
+    thread_local std::minstd_rand random(std::random_device{}());
+    int level = 1;
+    while (level < MAX_LEVEL && random() % LEVEL_ODDS == 0) level++;
+    return level;
+}
+
+// member must be absent
+void SortedSet::insertNode(double score, std::string_view member) {
+    SkipList& list = *list_;
+    Node* update[MAX_LEVEL];
+    size_t rank[MAX_LEVEL];
+
+    // the last node before the new one on each level, and its rank
+    Node* x = list.header;
+    for (int i = list.level - 1; i >= 0; i--) {
+        rank[i] = i == list.level - 1 ? 0 : rank[i + 1];
+        while (Node* next = x->levels()[i].forward) {
+            if (!before(next->score, next->member(), score, member)) break;
+            rank[i] += x->levels()[i].span;
+            x = next;
+        }
+        update[i] = x;
+    }
+
+    int level = randomLevel();
+    if (level > list.level) {
+        for (int i = list.level; i < level; i++) {
+            rank[i] = 0;
+            update[i] = list.header;
+            update[i]->levels()[i].span = list.length;
+        }
+        list.level = level;
+    }
+
+    x = createNode(list, level, score, member);
+    for (int i = 0; i < level; i++) {
+        Level& previous = update[i]->levels()[i];
+        x->levels()[i].forward = previous.forward;
+        previous.forward = x;
+        // the new node splits previous's span at its own rank
+        x->levels()[i].span = previous.span - (rank[0] - rank[i]);
+        previous.span = rank[0] - rank[i] + 1;
+    }
+    // links above the new node's height now jump over one more node
+    for (int i = level; i < list.level; i++) update[i]->levels()[i].span++;
+
+    x->backward = update[0] == list.header ? nullptr : update[0];
+    if (x->levels()[0].forward) x->levels()[0].forward->backward = x;
+    else list.tail = x;
+    list.length++;
+    list.index.emplace(x->member(), x);
+}
+
+void SortedSet::removeNode(Node* node) {
+    SkipList& list = *list_;
+    Node* update[MAX_LEVEL];
+    Node* x = list.header;
+    for (int i = list.level - 1; i >= 0; i--) {
+        while (Node* next = x->levels()[i].forward) {
+            if (!before(next->score, next->member(), node->score, node->member())) break;
+            x = next;
+        }
+        update[i] = x;
+    }
+
+    for (int i = 0; i < list.level; i++) {
+        Level& previous = update[i]->levels()[i];
+        if (previous.forward == node) {
+            previous.span += node->levels()[i].span - 1;
+            previous.forward = node->levels()[i].forward;
+        } else {
+            previous.span--;
+        }
+    }
+    if (node->levels()[0].forward) node->levels()[0].forward->backward = node->backward;
+    else list.tail = node->backward;
+    while (list.level > 1 && !list.header->levels()[list.level - 1].forward) list.level--;
+    list.length--;
+
+    list.index.erase(node->member());
+    destroyNode(list, node);
+}
+
+const SortedSet::Node* SortedSet::nodeAtRank(size_t rank) const {
+    // spans count from the header, which sits at rank 0, so the first member is at 1
+    size_t target = rank + 1;
+    size_t traversed = 0;
+    const Node* x = list_->header;
+    for (int i = list_->level - 1; i >= 0; i--) {
+        while (x->levels()[i].forward && traversed + x->levels()[i].span <= target) {
+            traversed += x->levels()[i].span;
+            x = x->levels()[i].forward;
+        }
+        if (traversed == target) return x;
+    }
+    return nullptr;
+}
+
+const SortedSet::Node* SortedSet::firstInRange(const ScoreRange& range) const {
+    const Node* x = list_->header;
+    for (int i = list_->level - 1; i >= 0; i--) {
+        while (x->levels()[i].forward && !range.aboveMin(x->levels()[i].forward->score)) {
+            x = x->levels()[i].forward;
+        }
+    }
+    return x->levels()[0].forward;
+}
+
+// ---- both encodings ----
+
+std::optional<double> SortedSet::score(std::string_view member) const {
+    if (list_) {
+        auto it = list_->index.find(member);
+        if (it == list_->index.end()) return std::nullopt;
+        return it->second->score;
+    }
+    uint32_t offset = locate(member);
+    if (offset == used_) return std::nullopt;
+    return readScore(readMember(data_ + offset));
+}
+
+bool SortedSet::set(std::string_view member, double score) {
+    if (!list_) {
+        uint32_t offset = locate(member);
+        if (offset < used_) {
+            if (readScore(readMember(data_ + offset)) == score) return false;
+            eraseCompactAt(offset);
+            insertCompact(member, score);
+            return false;
+        }
+        if (member.size() <= maxCompactValue_ && count_ < maxCompactEntries_) {
+            insertCompact(member, score);
+            return true;
+        }
+        convertToSkipList();
+    }
+
+    auto it = list_->index.find(member);
+    if (it == list_->index.end()) {
+        insertNode(score, member);
+        return true;
+    }
+    Node* node = it->second;
+    if (node->score == score) return false;
+    // a new score may move it anywhere, so it goes out and back in
+    removeNode(node);
+    insertNode(score, member);
+    return false;
+}
+
+bool SortedSet::erase(std::string_view member) {
+    if (list_) {
+        auto it = list_->index.find(member);
+        if (it == list_->index.end()) return false;
+        removeNode(it->second);
+        return true;
+    }
+    uint32_t offset = locate(member);
+    if (offset == used_) return false;
+    eraseCompactAt(offset);
+    return true;
+}
+
+std::optional<size_t> SortedSet::rank(std::string_view member) const {
+    if (!list_) {
+        size_t index = 0;
+        if (locate(member, &index) == used_) return std::nullopt;
+        return index;
+    }
+    auto it = list_->index.find(member);
+    if (it == list_->index.end()) return std::nullopt;
+    const Node* node = it->second;
+
+    // sum the spans on the way down to the node
+    size_t traversed = 0;
+    const Node* x = list_->header;
+    for (int i = list_->level - 1; i >= 0; i--) {
+        while (const Node* next = x->levels()[i].forward) {
+            if (before(node->score, node->member(), next->score, next->member())) break;
+            traversed += x->levels()[i].span;
+            x = next;
+        }
+        if (x == node) return traversed - 1;
+    }
+    return std::nullopt;
+}
@@ -0,0 +1,212 @@
+#ifndef SORTED_SET_HPP
+#define SORTED_SET_HPP
+
+#include <string>
+#include <string_view>
+#include <optional>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include "SlabAllocator.hpp"
+
+// Sorted set value: unique members ordered by (score, member), stored in one of two
+// encodings:
+//   Compact  - members and scores packed back to back in one buffer, already in order;
+//              lookups and inserts scan it. Small sets cost a single allocation.
+//   SkipList - Redis's zset layout, once the set outgrows the compact limits (more than
+//              maxEntries members, or a member longer than maxValue bytes): a skiplist
+//              whose links carry spans, so rank lookups are O(log n), plus a hash index
+//              from member to node for O(1) score lookups. Never converts back.
+// Like Redis's zset-max-listpack-entries / zset-max-listpack-value, the limits are set
+// from the command line. Ranks are 0-based. Not thread-safe: the owning shard's lock
+// covers it.
+class SortedSet {
+public:
+    static constexpr size_t DEFAULT_MAX_COMPACT_ENTRIES = 128;
+    static constexpr size_t DEFAULT_MAX_COMPACT_VALUE = 64;
+
+    // Set while parsing the command line, before any sorted set is created.
+    static void setCompactLimits(size_t maxEntries, size_t maxValue);
+
+    // scores between min and max, each end inclusive unless flagged exclusive
+    struct ScoreRange {
+        double min;
+        double max;
+        bool minExclusive = false;
+        bool maxExclusive = false;
+
+        bool aboveMin(double score) const { return minExclusive ? score > min : score >= min; }
+        bool belowMax(double score) const { return maxExclusive ? score < max : score <= max; }
+        bool empty() const { return min > max || (min == max && (minExclusive || maxExclusive)); }
+    };
+
+    SortedSet() = default;
+    SortedSet(SortedSet&& other) noexcept;
+    SortedSet& operator=(SortedSet&& other) noexcept;
+    ~SortedSet();
+
+    SortedSet(const SortedSet&) = delete;
+    SortedSet& operator=(const SortedSet&) = delete;
+
+    bool isCompact() const { return !list_; }
+    size_t size() const { return list_ ? list_->length : count_; }
+    bool empty() const { return size() == 0; }
+    // heap bytes held: the compact buffer, or the skiplist nodes and the index
+    size_t bytes() const;
+
+    std::optional<double> score(std::string_view member) const;
+    // Add member or move it to a new score. True if member is new. member must not point
+    // into this set.
+    bool set(std::string_view member, double score);
+    // false if member was absent
+    bool erase(std::string_view member);
+    // position of member in ascending order, or nullopt if absent
+    std::optional<size_t> rank(std::string_view member) const;
+
+    // Call fn(std::string_view member, double score) for ranks start..stop inclusive, in
+    // order. Requires start <= stop < size().
+    template <typename Fn>
+    void forRange(size_t start, size_t stop, Fn&& fn) const {
+        size_t remaining = stop - start + 1;
+        if (list_) {
+            for (const Node* node = nodeAtRank(start); node && remaining > 0; node = node->levels()[0].forward) {
+                fn(node->member(), node->score);
+                remaining--;
+            }
+            return;
+        }
+        size_t index = 0;
+        for (const char* pos = data_; pos < data_ + used_ && remaining > 0; index++) {
+            std::string_view member = readMember(pos);
+            double score = readScore(member);
+            pos = member.data() + member.size() + sizeof(double);
+            if (index < start) continue;
+            fn(member, score);
+            remaining--;
+        }
+    }
+
+    // Call fn(std::string_view member, double score) for members whose score is in range, in
+    // order, skipping the first offset of them and stopping after limit.
+    template <typename Fn>
+    void forScoreRange(const ScoreRange& range, size_t offset, size_t limit, Fn&& fn) const {
+        if (range.empty()) return;
+        if (list_) {
+            for (const Node* node = firstInRange(range); node && limit > 0 && range.belowMax(node->score);
+                 node = node->levels()[0].forward) {
+                if (offset > 0) {
+                    offset--;
+                    continue;
+                }
+                fn(node->member(), node->score);
+                limit--;
+            }
+            return;
+        }
+        for (const char* pos = data_; pos < data_ + used_ && limit > 0;) {
+            std::string_view member = readMember(pos);
+            double score = readScore(member);
+            pos = member.data() + member.size() + sizeof(double);
+            if (!range.aboveMin(score)) continue;
+            if (!range.belowMax(score)) break;
+            if (offset > 0) {
+                offset--;
+                continue;
+            }
+            fn(member, score);
+            limit--;
+        }
+    }
+
+private:
+    static constexpr int MAX_LEVEL = 32;        // enough for 4^32 members
+    static constexpr uint32_t LEVEL_ODDS = 4;   // a node reaches each next level with probability 1/4
+
+    struct Node;
+    struct Level {
+        Node* forward;
+        size_t span;  // rank distance to forward (to the end of the list when forward is null)
+    };
+    // Header, then levelCount Levels, then the member's bytes, in one slab allocation.
+    struct Node {
+        double score;
+        Node* backward;
+        uint32_t memberLength;
+        uint32_t levelCount;
+
+        Level* levels() { return reinterpret_cast<Level*>(this + 1); }
+        const Level* levels() const { return reinterpret_cast<const Level*>(this + 1); }
+        std::string_view member() const {
+            return {reinterpret_cast<const char*>(levels() + levelCount), memberLength};
+        }
+        static size_t bytesFor(size_t levelCount, size_t memberLength) {
+            return sizeof(Node) + levelCount * sizeof(Level) + memberLength;
+        }
+    };
+
+    struct MemberHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view member) const { return std::hash<std::string_view>{}(member); }
+    };
+    // keys are views of the nodes' own member bytes
+    using Index = std::unordered_map<std::string_view, Node*, MemberHash, std::equal_to<>,
+                                     SlabStlAllocator<std::pair<const std::string_view, Node*>>>;
+    // what an index node costs: next pointer, cached hash, pair
+    static constexpr size_t INDEX_NODE_BYTES = sizeof(void*) + sizeof(size_t) + sizeof(Index::value_type);
+
+    struct SkipList {
+        Node* header;  // MAX_LEVEL levels, no member
+        Node* tail = nullptr;
+        size_t length = 0;
+        int level = 1;  // levels in use
+        Index index;
+        size_t nodeBytes = 0;  // slab bytes of every node, header included
+    };
+
+    static inline size_t maxCompactEntries_ = DEFAULT_MAX_COMPACT_ENTRIES;
+    static inline size_t maxCompactValue_ = DEFAULT_MAX_COMPACT_VALUE;
+
+    // compact encoding: data_[0, used_) holds count_ member/score pairs in order
+    char* data_ = nullptr;
+    uint32_t used_ = 0;
+    uint32_t capacity_ = 0;
+    uint32_t count_ = 0;
+    // skiplist encoding; null while compact
+    std::unique_ptr<SkipList> list_;
+
+    // a member is prefixed by its length (one byte under 128, else five) and followed by
+    // its score's 8 bytes
+    static constexpr uint8_t LONG_LENGTH = 0x80;
+
+    static size_t headerSize(size_t length) { return length < LONG_LENGTH ? 1 : 5; }
+    static size_t entrySize(size_t length) { return headerSize(length) + length + sizeof(double); }
+    static void writeEntry(char* pos, std::string_view member, double score);
+    static std::string_view readMember(const char* pos);
+    static double readScore(std::string_view member);  // member as returned by readMember
+
+    // (score, member) order shared by both encodings
+    static bool before(double score, std::string_view member, double otherScore, std::string_view otherMember) {
+        return score < otherScore || (score == otherScore && member < otherMember);
+    }
+
+    // offset of member's entry in data_ (used_ if absent), and its index in *index
+    uint32_t locate(std::string_view member, size_t* index = nullptr) const;
+    void insertCompact(std::string_view member, double score);
+    void eraseCompactAt(uint32_t offset);
+    void reserve(size_t needed);
+    void convertToSkipList();
+    void freeCompact();
+
+    static Node* createNode(SkipList& list, int levelCount, double score, std::string_view member);
+    static void destroyNode(SkipList& list, Node* node);
+    static void destroySkipList(SkipList& list);
+    static int randomLevel();
+    void insertNode(double score, std::string_view member);
+    void removeNode(Node* node);
+    const Node* nodeAtRank(size_t rank) const;
+    const Node* firstInRange(const ScoreRange& range) const;
+};
+
+#endif // SORTED_SET_HPP
@@ -0,0 +1,159 @@
+#include "StringValue.hpp"
+#include "SlabAllocator.hpp"
+#include <charconv>
+#include <cstring>
+
+bool StringValue::parseInteger(std::string_view text, int64_t& value) {
+    if (text.empty() || text.size() > MAX_INTEGER_LENGTH) return false;
+    // reject what would print differently: "007", "-0", "-012" ("+1" fails from_chars)
+    size_t digits = text[0] == '-' ? 1 : 0;
+    if (digits == text.size()) return false;
+    if (text[digits] == '0' && text.size() > 1) return false;
+
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc() && ptr == text.data() + text.size();
+}
+
+StringValue::StringValue(std::string_view text) {
+    int64_t value;
+    if (parseInteger(text, value)) {
+        encoding_ = Encoding::Int;
+        size_ = 0;
+        std::memcpy(data_, &value, sizeof(value));
+    } else if (text.size() <= EMBED_CAPACITY) {
+        encoding_ = Encoding::Embedded;
+        size_ = static_cast<uint8_t>(text.size());
+        std::memcpy(data_, text.data(), text.size());
+    } else {
+        encoding_ = Encoding::Raw;
+        size_ = 0;
+        char* buffer = static_cast<char*>(SlabAllocator::allocate(text.size()));
+        std::memcpy(buffer, text.data(), text.size());
+        size_t length = text.size();
+        std::memcpy(data_, &buffer, sizeof(buffer));
+        std::memcpy(data_ + sizeof(buffer), &length, sizeof(length));
+    }
+}
+
+StringValue StringValue::fromInteger(int64_t value) {
+    StringValue result;
+    result.encoding_ = Encoding::Int;
+    std::memcpy(result.data_, &value, sizeof(value));
+    return result;
+}
+
+StringValue::StringValue(const StringValue& other) {
+    copyFrom(other);
+}
+
+StringValue::StringValue(StringValue&& other) noexcept {
+    // a bitwise copy moves every encoding; the source just forgets its buffer
+    copyBits(other);
+    other.encoding_ = Encoding::Embedded;
+    other.size_ = 0;
+}
+
+StringValue& StringValue::operator=(const StringValue& other) {
+    if (this != &other) {
+        release();
+        copyFrom(other);
+    }
+    return *this;
+}
+
+StringValue& StringValue::operator=(StringValue&& other) noexcept {
+    if (this != &other) {
+        release();
+        copyBits(other);
+        other.encoding_ = Encoding::Embedded;
+        other.size_ = 0;
+    }
+    return *this;
+}
+
+StringValue::~StringValue() {
+    release();
+}
+
+void StringValue::release() {
+    if (encoding_ == Encoding::Raw) SlabAllocator::deallocate(const_cast<char*>(rawData()), rawSize());
+}
+
+void StringValue::copyBits(const StringValue& other) {
+    std::memcpy(data_, other.data_, sizeof(data_));
+    size_ = other.size_;
+    encoding_ = other.encoding_;
+}
+
+void StringValue::copyFrom(const StringValue& other) {
+    if (other.encoding_ != Encoding::Raw) {
+        copyBits(other);
+        return;
+    }
+    encoding_ = Encoding::Raw;
+    size_ = 0;
+    size_t length = other.rawSize();
+    char* buffer = static_cast<char*>(SlabAllocator::allocate(length));
+    std::memcpy(buffer, other.rawData(), length);
+    std::memcpy(data_, &buffer, sizeof(buffer));
+    std::memcpy(data_ + sizeof(buffer), &length, sizeof(length));
+}
+
+const char* StringValue::rawData() const {
+    const char* buffer;
+    std::memcpy(&buffer, data_, sizeof(buffer));
+    return buffer;
+}
+
+size_t StringValue::heapBytes() const {
+    return encoding_ == Encoding::Raw ? SlabAllocator::chunkSize(rawSize()) : 0;
+}
+
+size_t StringValue::rawSize() const {
+    size_t length;
+    std::memcpy(&length, data_ + sizeof(char*), sizeof(length));
+    return length;
+}
+
+int64_t StringValue::integer() const {
+    int64_t value;
+    std::memcpy(&value, data_, sizeof(value));
+    return value;
+}
+
+size_t StringValue::size() const {
+    switch (encoding_) {
+        case Encoding::Int: {
+            char digits[MAX_INTEGER_LENGTH];
+            return std::to_chars(digits, digits + sizeof(digits), integer()).ptr - digits;
+        }
+        case Encoding::Embedded:
+            return size_;
+        case Encoding::Raw:
+            return rawSize();
+    }
+    return 0;
+}
+
+void StringValue::appendTo(std::string& out) const {
+    switch (encoding_) {
+        case Encoding::Int: {
+            char digits[MAX_INTEGER_LENGTH];
+            char* end = std::to_chars(digits, digits + sizeof(digits), integer()).ptr;
+            out.append(digits, end - digits);
+            break;
+        }
+        case Encoding::Embedded:
+            out.append(data_, size_);
+            break;
+        case Encoding::Raw:
+            out.append(rawData(), rawSize());
+            break;
+    }
+}
+
+std::string StringValue::str() const {
+    std::string text;
+    appendTo(text);
+    return text;
+}
@@ -0,0 +1,65 @@
+#ifndef STRING_VALUE_HPP
+#define STRING_VALUE_HPP
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+// A string value, stored in whichever of three encodings fits its contents:
+//   Int      - a canonical decimal integer in int64_t range, kept as the number itself,
+//              so INCR and friends never parse or print
+//   Embedded - up to EMBED_CAPACITY bytes kept inline, no heap allocation
+//   Raw      - anything longer, in one buffer from the slab allocator
+// The encoding is picked on construction and is invisible to readers of the text.
+// Fields are byte arrays (accessed via memcpy) so the whole value packs into 32 bytes.
+class StringValue {
+public:
+    enum class Encoding : uint8_t { Int, Embedded, Raw };
+
+    static constexpr size_t EMBED_CAPACITY = 30;
+    static constexpr size_t MAX_INTEGER_LENGTH = 20;  // "-9223372036854775808"
+
+    StringValue() : size_(0), encoding_(Encoding::Embedded) {}
+    explicit StringValue(std::string_view text);
+    static StringValue fromInteger(int64_t value);
+
+    StringValue(const StringValue& other);
+    StringValue(StringValue&& other) noexcept;
+    StringValue& operator=(const StringValue& other);
+    StringValue& operator=(StringValue&& other) noexcept;
+    ~StringValue();
+
+    Encoding encoding() const { return encoding_; }
+    bool isInteger() const { return encoding_ == Encoding::Int; }
+    int64_t integer() const;  // only for isInteger()
+
+    // length of the text form
+    size_t size() const;
+    // append the text form to out
+    void appendTo(std::string& out) const;
+    std::string str() const;
+
+    // bytes allocated beyond sizeof(StringValue)
+    size_t heapBytes() const;
+
+    // true if text is exactly how int64_t value would print: no sign but '-', no leading
+    // zeros, no "-0". Only such strings are integer-encoded, so the text round-trips.
+    static bool parseInteger(std::string_view text, int64_t& value);
+
+private:
+    // Int: int64_t at 0. Embedded: text at 0, length in size_. Raw: char* at 0, size_t at 8.
+    char data_[EMBED_CAPACITY];
+    uint8_t size_;
+    Encoding encoding_;
+
+    const char* rawData() const;
+    size_t rawSize() const;
+    void release();
+    void copyBits(const StringValue& other);   // shares a Raw buffer
+    void copyFrom(const StringValue& other);   // duplicates a Raw buffer
+};
+
+static_assert(sizeof(StringValue) == 32, "StringValue should pack into 32 bytes");
+
+#endif // STRING_VALUE_HPP
@@ -0,0 +1,200 @@
+#include "command_table.hpp"
+#include "handler.hpp"
+#include "MasterServer.hpp"
+#include "BlockingRegistry.hpp"
+#include <array>
+#include <string>
+#include <span>
+#include <chrono>
+#include <charconv>
+#include <algorithm>
+
+namespace {
+    constexpr char foldCase(char c) {
+        return (c >= 'a' && c <= 'z') ? static_cast<char>(c - ('a' - 'A')) : c;
+    }
+
+    // FNV-1a over the upper-cased name, so "get", "GET" and "Get" land in the same slot
+    constexpr uint32_t hashName(std::string_view name) {
+        uint32_t hash = 2166136261u;
+        for (char c : name) {
+            hash ^= static_cast<unsigned char>(foldCase(c));
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    template <void (Handler::*Method)(const CommandArgs&, ReplyBuilder&)>
+    void callHandler(CommandContext& ctx) {
+        (ctx.handler.*Method)(ctx.args, ctx.reply);
+    }
+
+    void pingCommand(CommandContext& ctx) {
+        if (ctx.args.size() > 1) {
+            ctx.reply.bulkString(ctx.args[1]);
+        } else {
+            ctx.reply.simpleString("PONG");
+        }
+    }
+
+    // REPLICA host port: add a replica
+    void replicaCommand(CommandContext& ctx) {
+        if (!ctx.master) {
+            ctx.reply.error("ERR invalid REPLICA command or not a master");
+            return;
+        }
+        std::string host(ctx.args[1]);
+        int port = std::stoi(std::string(ctx.args[2]));
+        ctx.master->addReplica(host, port);
+        ctx.reply.simpleString("OK");
+    }
+
+    void replicasCommand(CommandContext& ctx) {
+        MasterServer* master = ctx.master;
+        std::string info = "Connected replicas: " + std::to_string(master->getConnectedReplicaCount()) + "\n";
+        info += master->getMasterInfo() + "\n";
+
+        auto replicaList = master->getReplicaList();
+        for (const auto& replica : replicaList) {
+            info += "- " + replica.first + ":" + std::to_string(replica.second) + "\n";
+        }
+
+        ctx.reply.bulkString(info);
+    }
+
+    // BLPOP/BRPOP key [key ...] timeout
+    // Pops from the first non-empty key, else parks the client until a push to any of the
+    // keys or the timeout (seconds, 0 = forever) runs out. Replies [key, element] or nil.
+    template <bool FromHead>
+    void blockingPopCommand(CommandContext& ctx) {
+        if (!ctx.client) {
+            ctx.reply.error("ERR blocking commands are not allowed here");
+            return;
+        }
+        std::string_view timeoutArg = ctx.args.back();
+        double timeout = 0;
+        auto [ptr, ec] = std::from_chars(timeoutArg.data(), timeoutArg.data() + timeoutArg.size(), timeout);
+        if (ec != std::errc() || ptr != timeoutArg.data() + timeoutArg.size()) {
+            ctx.reply.error("ERR timeout is not a float or out of range");
+            return;
+        }
+        if (timeout < 0) {
+            ctx.reply.error("ERR timeout is negative");
+            return;
+        }
+
+        std::span<const std::string_view> keys(ctx.args.begin() + 1, ctx.args.end() - 1);
+        BlockingRegistry& registry = BlockingRegistry::getInstance();
+        try {
+            auto popped = registry.popOrBlock(*ctx.client, keys, FromHead);
+            if (!popped) {
+                if (timeout > 0) {
+                    timeout = std::min(timeout, 1e9);  // ~30 years; keeps the ms count in range
+                    registry.armTimeout(*ctx.client, std::chrono::milliseconds(static_cast<int64_t>(timeout * 1000)));
+                }
+                return;  // the reply comes when the client is released
+            }
+            ctx.reply.arrayHeader(2);
+            ctx.reply.bulkString(popped->first);
+            ctx.reply.bulkString(popped->second);
+            if (ctx.master) {
+                CommandArgs pop{FromHead ? "LPOP" : "RPOP", popped->first};
+                ctx.master->propagateWrite(pop);
+            }
+        } catch (const std::exception& e) {
+            ctx.reply.error(std::string("ERR ") + e.what());
+        }
+    }
+
+    constexpr CommandSpec commands[] = {
+        {"GET",      2,  CMD_READ,  callHandler<&Handler::handleGet>},
+        {"SET",      -3, CMD_WRITE | CMD_DENYOOM, callHandler<&Handler::handleSet>},
+        {"EXISTS",   -2, CMD_READ,  callHandler<&Handler::handleExists>},
+        {"DEL",      -2, CMD_WRITE, callHandler<&Handler::handleDel>},
+        {"MGET",     -2, CMD_READ,  callHandler<&Handler::handleMGet>},
+        {"MSET",     -3, CMD_WRITE | CMD_DENYOOM, callHandler<&Handler::handleMSet>},
+        {"INCR",     2,  CMD_WRITE | CMD_DENYOOM, callHandler<&Handler::handleIncr>},
+        {"DECR",     2,  CMD_WRITE | CMD_DENYOOM, callHandler<&Handler::handleDecr>},
+        {"INCRBY",   3,  CMD_WRITE | CMD_DENYOOM, callHandler<&Handler::handleIncrBy>},
+        {"DECRBY",   3,  CMD_WRITE | CMD_DENYOOM, callHandler<&Handler::handleDecrBy>},
+        {"LPUSH",    -3, CMD_WRITE | CMD_DENYOOM, callHandler<&Handler::handleLPush>},
+        {"RPUSH",    -3, CMD_WRITE | CMD_DENYOOM, callHandler<&Handler::handleRPush>},
+        {"LRANGE",   4,  CMD_READ,  callHandler<&Handler::handleLRange>},
+        {"LLEN",     2,  CMD_READ,  callHandler<&Handler::handleLLen>},
+        {"LINDEX",   3,  CMD_READ,  callHandler<&Handler::handleLIndex>},
+        {"LPOP",     -2, CMD_WRITE, callHandler<&Handler::handleLPop>},
+        {"RPOP",     -2, CMD_WRITE, callHandler<&Handler::handleRPop>},
+        {"LTRIM",    4,  CMD_WRITE, callHandler<&Handler::handleLTrim>},
+        {"BLPOP",    -3, CMD_WRITE | CMD_BLOCKING, blockingPopCommand<true>},
+        {"BRPOP",    -3, CMD_WRITE | CMD_BLOCKING, blockingPopCommand<false>},
+        {"HSET",     -4, CMD_WRITE | CMD_DENYOOM, callHandler<&Handler::handleHSet>},
+        {"HGET",     3,  CMD_READ,  callHandler<&Handler::handleHGet>},
+        {"HMGET",    -3, CMD_READ,  callHandler<&Handler::handleHMGet>},
+        {"HDEL",     -3, CMD_WRITE, callHandler<&Handler::handleHDel>},
+        {"HGETALL",  2,  CMD_READ,  callHandler<&Handler::handleHGetAll>},
+        {"HINCRBY",  4,  CMD_WRITE | CMD_DENYOOM, callHandler<&Handler::handleHIncrBy>},
+        {"HLEN",     2,  CMD_READ,  callHandler<&Handler::handleHLen>},
+        {"ZADD",     -4, CMD_WRITE | CMD_DENYOOM, callHandler<&Handler::handleZAdd>},
+        {"ZINCRBY",  4,  CMD_WRITE | CMD_DENYOOM, callHandler<&Handler::handleZIncrBy>},
+        {"ZREM",     -3, CMD_WRITE, callHandler<&Handler::handleZRem>},
+        {"ZSCORE",   3,  CMD_READ,  callHandler<&Handler::handleZScore>},
+        {"ZRANK",    3,  CMD_READ,  callHandler<&Handler::handleZRank>},
+        {"ZCARD",    2,  CMD_READ,  callHandler<&Handler::handleZCard>},
+        {"ZRANGE",   -4, CMD_READ,  callHandler<&Handler::handleZRange>},
+        {"ZRANGEBYSCORE", -4, CMD_READ, callHandler<&Handler::handleZRangeByScore>},
+        {"MEMORY",   -2, CMD_READ,  callHandler<&Handler::handleMemory>},
+        {"PING",     -1, CMD_READ,  pingCommand},
+        {"INFO",     -1, CMD_REPLICATION, nullptr},
+        {"REPLCONF", -2, CMD_REPLICATION, nullptr},
+        {"PSYNC",    -3, CMD_REPLICATION, nullptr},
+        {"WAIT",     -3, CMD_REPLICATION, nullptr},
+        {"REPLICA",  3,  CMD_MASTER_ONLY, replicaCommand},
+        {"REPLICAS", 1,  CMD_MASTER_ONLY, replicasCommand},
+    };
+
+    constexpr size_t NUM_COMMANDS = sizeof(commands) / sizeof(commands[0]);
+    constexpr size_t INDEX_SIZE = 128;  // power of two, kept under half full so probes stay short
+    constexpr uint8_t EMPTY_SLOT = 0xFF;
+    static_assert(NUM_COMMANDS * 2 <= INDEX_SIZE, "command index too full; grow INDEX_SIZE");
+
+    // open-addressed index into commands[], filled in at compile time
+    constexpr std::array<uint8_t, INDEX_SIZE> buildIndex() {
+        std::array<uint8_t, INDEX_SIZE> index{};
+        for (auto& slot : index) slot = EMPTY_SLOT;
+        for (size_t i = 0; i < NUM_COMMANDS; i++) {
+            size_t slot = hashName(commands[i].name) & (INDEX_SIZE - 1);
+            while (index[slot] != EMPTY_SLOT) {
+                slot = (slot + 1) & (INDEX_SIZE - 1);
+            }
+            index[slot] = static_cast<uint8_t>(i);
+        }
+        return index;
+    }
+
+    constexpr std::array<uint8_t, INDEX_SIZE> commandIndex = buildIndex();
+}
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (foldCase(a[i]) != foldCase(b[i])) return false;
+    }
+    return true;
+}
+
+const CommandSpec* lookupCommand(std::string_view name) {
+    size_t slot = hashName(name) & (INDEX_SIZE - 1);
+    while (commandIndex[slot] != EMPTY_SLOT) {
+        const CommandSpec& spec = commands[commandIndex[slot]];
+        if (equalsIgnoreCase(spec.name, name)) return &spec;
+        slot = (slot + 1) & (INDEX_SIZE - 1);
+    }
+    return nullptr;
+}
+
+void replyWrongArity(ReplyBuilder& reply, std::string_view command) {
+    std::string message = "ERR wrong number of arguments for '";
+    message.append(command);
+    message += "' command";
+    reply.error(message);
+}
@@ -0,0 +1,58 @@
+#ifndef COMMAND_TABLE_HPP
+#define COMMAND_TABLE_HPP
+
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include "resp_parser.hpp"
+#include "reply_builder.hpp"
+
+class Handler;
+class MasterServer;
+struct Connection;
+
+// What a command does, so each role can decide how to run it without knowing its name
+enum CommandFlags : uint32_t {
+    CMD_READ        = 1 << 0,  // only reads the keyspace; served by replicas too
+    CMD_WRITE       = 1 << 1,  // modifies the keyspace; propagated by the master, READONLY on replicas
+    CMD_REPLICATION = 1 << 2,  // handled by the role's own replication code (INFO, REPLCONF, ...)
+    CMD_MASTER_ONLY = 1 << 3,  // manages replicas; not available on a replica
+    CMD_BLOCKING    = 1 << 4,  // may park the client; propagates what it did itself (BLPOP as LPOP)
+    CMD_DENYOOM     = 1 << 5,  // may grow memory; refused while over --maxmemory and nothing can be evicted
+};
+
+// everything a command implementation may touch; master is null on a replica, client is
+// null when the command doesn't come from a client socket of an event loop
+struct CommandContext {
+    const CommandArgs& args;
+    ReplyBuilder& reply;
+    Handler& handler;
+    MasterServer* master;
+    Connection* client;
+};
+
+using CommandProc = void (*)(CommandContext& ctx);
+
+struct CommandSpec {
+    std::string_view name;  // upper case
+    int arity;              // Redis convention: n means exactly n args (name included), -n at least n
+    uint32_t flags;
+    CommandProc proc;       // null for CMD_REPLICATION commands, which each role implements
+
+    bool hasFlag(uint32_t flag) const { return (flags & flag) != 0; }
+    bool arityMatches(size_t argc) const {
+        return arity >= 0 ? argc == static_cast<size_t>(arity) : argc >= static_cast<size_t>(-arity);
+    }
+};
+
+// Case-insensitive lookup of argv[0]; nullptr for unknown commands.
+// Constant time and allocation-free: one hash of the name, then a probe of a table built at compile time.
+const CommandSpec* lookupCommand(std::string_view name);
+
+// ASCII case-insensitive comparison, for subcommands and option names
+bool equalsIgnoreCase(std::string_view a, std::string_view b);
+
+// "ERR wrong number of arguments for '<cmd>' command"
+void replyWrongArity(ReplyBuilder& reply, std::string_view command);
+
+#endif // COMMAND_TABLE_HPP
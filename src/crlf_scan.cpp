@@ -0,0 +1,76 @@
+#include "crlf_scan.hpp"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CRLF_SCAN_X86 1
+#endif
+
+namespace {
+    using ScanFn = const char* (*)(const char*, const char*);
+
+    // portable fallback for non-x86 targets
+    const char* scanScalar(const char* begin, const char* end) {
+        return static_cast<const char*>(memchr(begin, '\r', end - begin));
+    }
+
+#ifdef CRLF_SCAN_X86
+    // compiled for SSE2 regardless of the global flags; every x86-64 CPU has it
+    __attribute__((target("sse2")))
+    const char* scanSSE2(const char* begin, const char* end) {
+        const __m128i cr = _mm_set1_epi8('\r');
+        const char* p = begin;
+        for (; end - p >= 16; p += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, cr));
+            if (mask) return p + __builtin_ctz(mask);
+        }
+        for (; p < end; p++) {  // tail shorter than one block
+            if (*p == '\r') return p;
+        }
+        return nullptr;
+    }
+
+    // only called after the CPU has been checked for AVX2
+    __attribute__((target("avx2")))
+    const char* scanAVX2(const char* begin, const char* end) {
+        const __m256i cr = _mm256_set1_epi8('\r');
+        const char* p = begin;
+        for (; end - p >= 32; p += 32) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, cr)));
+            if (mask) return p + __builtin_ctz(mask);
+        }
+        for (; p < end; p++) {
+            if (*p == '\r') return p;
+        }
+        return nullptr;
+    }
+#endif
+
+    struct Kernel {
+        ScanFn fn;
+        const char* name;
+    };
+
+    Kernel selectKernel() {
+#ifdef CRLF_SCAN_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return {scanAVX2, "avx2"};
+        if (__builtin_cpu_supports("sse2")) return {scanSSE2, "sse2"};
+#endif
+        return {scanScalar, "scalar"};
+    }
+
+    // resolved during static initialization, before any connection is parsed
+    const Kernel kernel = selectKernel();
+}
+
+const char* findCR(const char* begin, const char* end) {
+    if (begin >= end) return nullptr;
+    return kernel.fn(begin, end);
+}
+
+const char* crScanKernel() {
+    return kernel.name;
+}
@@ -0,0 +1,14 @@
+#ifndef CRLF_SCAN_HPP
+#define CRLF_SCAN_HPP
+
+#include <cstddef>
+
+// Returns the first '\r' in [begin, end), or nullptr if there is none.
+// On x86-64 the widest kernel the CPU supports (AVX2, else SSE2) is picked once at startup
+// and tests 32/16 bytes per step; other targets use the scalar fallback.
+const char* findCR(const char* begin, const char* end);
+
+// name of the kernel findCR dispatches to ("avx2", "sse2" or "scalar"), for the startup log
+const char* crScanKernel();
+
+#endif // CRLF_SCAN_HPP
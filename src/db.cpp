@@ -4,37 +4,488 @@
 #include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <cstdio>
+#include <charconv>
+#include <cmath>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>  // mallinfo2
+#endif
+#include "EpochManager.hpp"
+#include "ServerClock.hpp"
+#include "SlabAllocator.hpp"
+
+namespace {
+    const char* WRONGTYPE = "WRONGTYPE Operation against a key holding the wrong kind of value";
+
+    // 1.50M style, like Redis's bytesToHuman
+    std::string bytesToHuman(size_t bytes) {
+        const char* units = "BKMGTP";
+        double value = static_cast<double>(bytes);
+        int unit = 0;
+        while (value >= 1024 && unit < 5) {
+            value /= 1024;
+            unit++;
+        }
+        char text[32];
+        if (unit == 0) std::snprintf(text, sizeof(text), "%zuB", bytes);
+        else std::snprintf(text, sizeof(text), "%.2f%c", value, units[unit]);
+        return text;
+    }
+
+    const char* evictionPolicyName(DB::EvictionPolicy policy) {
+        switch (policy) {
+        case DB::EvictionPolicy::AllKeysLru: return "allkeys-lru";
+        case DB::EvictionPolicy::AllKeysLfu: return "allkeys-lfu";
+        case DB::EvictionPolicy::VolatileLru: return "volatile-lru";
+        case DB::EvictionPolicy::VolatileTtl: return "volatile-ttl";
+        default: return "noeviction";
+        }
+    }
+
+    // xorshift64*, per thread: eviction sampling and LFU increments only need cheap noise
+    uint64_t randomBits() {
+        thread_local uint64_t state = 0x9E3779B97F4A7C15ull ^ reinterpret_cast<uintptr_t>(&state);
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1Dull;
+    }
+}
 
 DB& DB::getInstance() {
     static DB instance;  // singleton
     return instance;
 }
 
+size_t DB::requestedShards_ = DB::DEFAULT_SHARDS;
+size_t DB::maxMemory_ = 0;
+DB::EvictionPolicy DB::evictionPolicy_ = DB::EvictionPolicy::NoEviction;
+
+void DB::setShardCount(size_t count) {
+    size_t shards = 1;
+    while (shards < count) shards <<= 1;
+    requestedShards_ = shards;
+}
+
 // start up db -> load from rdb file
-DB::DB() {
+DB::DB() : shards_(new Shard[requestedShards_]), shardMask_(requestedShards_ - 1) {
     loadRDB();
 }
 
+std::vector<std::shared_lock<std::shared_mutex>> DB::readLockAllShards() {
+    std::vector<std::shared_lock<std::shared_mutex>> locks;
+    locks.reserve(shardCount());
+    for (size_t i = 0; i < shardCount(); i++) {
+        locks.emplace_back(shards_[i].mutex);
+    }
+    return locks;
+}
+
 // shut down to db -> save to rdb file
 DB::~DB() {
     saveRDB();
 }
 
-// write string to ofstream:    length stringS
-void DB::writeString(std::ofstream &out, const std::string &s) {
+void DB::cron() {
+    activeExpireCycle();
+    updatePeakMemory();
+
+    auto deadline = std::chrono::steady_clock::now() + CRON_REHASH_BUDGET;
+    for (size_t i = 0; i < shardCount(); i++) {
+        Shard& shard = shards_[i];
+        bool more = true;
+        while (more) {
+            // a busy shard is skipped: its own writes keep its rehash moving
+            std::unique_lock<std::shared_mutex> lock(shard.mutex, std::try_to_lock);
+            if (!lock.owns_lock()) break;
+            more = shard.table.rehashStep(CRON_REHASH_BATCH);
+            lock.unlock();
+            if (std::chrono::steady_clock::now() >= deadline) return;
+        }
+    }
+}
+
+// Deletes due keys shard by shard in small locked batches until the budget runs out.
+// A cycle that runs out picks up next time from the shard it stopped in, so no shard is
+// starved. Afterwards, how much is left overdue feeds expired_stale_perc.
+void DB::activeExpireCycle() {
+    auto deadline = std::chrono::steady_clock::now() + CRON_EXPIRE_BUDGET;
+    long long now = ServerClock::nowMs();
+    bool timedOut = false;
+
+    for (size_t visited = 0; visited < shardCount() && !timedOut; visited++) {
+        size_t index = (expireCursor_ + visited) & shardMask_;
+        Shard& shard = shards_[index];
+        bool more = true;
+        while (more) {
+            {
+                std::lock_guard<std::shared_mutex> lock(shard.mutex);
+                expireDue(shard, now, CRON_EXPIRE_BATCH, more);
+            }
+            if (more && std::chrono::steady_clock::now() >= deadline) {
+                timedOut = true;
+                expireCursor_ = index;
+                break;
+            }
+        }
+    }
+
+    double current = 0;
+    if (timedOut) {
+        expireCycleTimeCapped_.fetch_add(1, std::memory_order_relaxed);
+        size_t overdue = 0;
+        size_t indexed = 0;
+        for (size_t i = 0; i < shardCount(); i++) {
+            std::shared_lock<std::shared_mutex> lock(shards_[i].mutex);
+            overdue += countOverdue(shards_[i], now);
+            indexed += shards_[i].expiries.size();
+        }
+        if (indexed > 0) current = 100.0 * overdue / indexed;
+    }
+    // smoothed the way Redis does, so one slow cycle doesn't swing the stat
+    double previous = expiredStalePerc_.load(std::memory_order_relaxed);
+    expiredStalePerc_.store(current * 0.05 + previous * 0.95, std::memory_order_relaxed);
+}
+
+size_t DB::expireDue(Shard& shard, long long now, size_t limit, bool& more) {
+    auto& heap = shard.expiries;
+    size_t deleted = 0;
+    size_t examined = 0;
+    more = false;
+    while (!heap.empty() && now > heap.front().expireAt) {
+        if (examined++ == limit) {
+            more = true;
+            break;
+        }
+        std::pop_heap(heap.begin(), heap.end(), std::greater<>{});
+        ExpiryEntry entry = std::move(heap.back());
+        heap.pop_back();
+        shard.expiryKeyBytes -= stringHeapBytes(entry.key);
+
+        // the key may since have been deleted or re-set with another TTL
+        KeyNode* node = shard.table.find(entry.key, entry.hash);
+        if (node && node->entry.expireAt == entry.expireAt) {
+            shard.table.erase(entry.key, entry.hash);
+            expiredKeys_.fetch_add(1, std::memory_order_relaxed);
+            deleted++;
+        }
+    }
+    publishExpiryBytes(shard);
+    return deleted;
+}
+
+void DB::publishExpiryBytes(Shard& shard) {
+    size_t bytes = shard.expiries.capacity() * sizeof(ExpiryEntry) + shard.expiryKeyBytes;
+    shard.expiryBytes.store(bytes, std::memory_order_relaxed);
+}
+
+size_t DB::countOverdue(const Shard& shard, long long now) {
+    // heap order: once an entry isn't due, none of its children are either
+    const auto& heap = shard.expiries;
+    size_t count = 0;
+    std::vector<size_t> pending;
+    if (!heap.empty()) pending.push_back(0);
+    while (!pending.empty() && count < STALE_SCAN_LIMIT) {
+        size_t i = pending.back();
+        pending.pop_back();
+        if (now <= heap[i].expireAt) continue;
+        count++;
+        if (2 * i + 1 < heap.size()) pending.push_back(2 * i + 1);
+        if (2 * i + 2 < heap.size()) pending.push_back(2 * i + 2);
+    }
+    return count;
+}
+
+void DB::trackExpiry(Shard& shard, const KeyNode& node) {
+    if (node.entry.expireAt == Entry::NO_EXPIRY) return;
+    auto& heap = shard.expiries;
+    heap.push_back({node.entry.expireAt, node.hash, node.key});
+    std::push_heap(heap.begin(), heap.end(), std::greater<>{});
+    shard.expiryKeyBytes += stringHeapBytes(heap.back().key);
+
+    // keys re-set before their TTL is up leave stale entries behind; once those are the
+    // majority, rebuild from the live keys
+    if (heap.size() > 1024 && heap.size() > 2 * shard.table.size()) {
+        heap.clear();
+        shard.expiryKeyBytes = 0;
+        shard.table.forEach([&shard, &heap](const KeyNode& live) {
+            if (live.entry.expireAt != Entry::NO_EXPIRY) {
+                heap.push_back({live.entry.expireAt, live.hash, live.key});
+                shard.expiryKeyBytes += stringHeapBytes(heap.back().key);
+            }
+        });
+        std::make_heap(heap.begin(), heap.end(), std::greater<>{});
+        heap.shrink_to_fit();
+    }
+    publishExpiryBytes(shard);
+}
+
+std::string DB::infoStats() const {
+    char stalePerc[32];
+    std::snprintf(stalePerc, sizeof(stalePerc), "%.2f", expiredStalePerc_.load(std::memory_order_relaxed));
+    std::string info = "# Stats\r\n";
+    info += "expired_keys:" + std::to_string(expiredKeys_.load(std::memory_order_relaxed)) + "\r\n";
+    info += "expired_stale_perc:" + std::string(stalePerc) + "\r\n";
+    info += "expired_time_cap_reached_count:" + std::to_string(expireCycleTimeCapped_.load(std::memory_order_relaxed)) + "\r\n";
+    info += "evicted_keys:" + std::to_string(evictedKeys_.load(std::memory_order_relaxed)) + "\r\n";
+    return info;
+}
+
+void DB::setMaxMemory(size_t bytes, EvictionPolicy policy) {
+    maxMemory_ = bytes;
+    evictionPolicy_ = policy;
+}
+
+std::optional<DB::EvictionPolicy> DB::parseEvictionPolicy(std::string_view name) {
+    if (name == "noeviction") return EvictionPolicy::NoEviction;
+    if (name == "allkeys-lru") return EvictionPolicy::AllKeysLru;
+    if (name == "allkeys-lfu") return EvictionPolicy::AllKeysLfu;
+    if (name == "volatile-lru") return EvictionPolicy::VolatileLru;
+    if (name == "volatile-ttl") return EvictionPolicy::VolatileTtl;
+    return std::nullopt;
+}
+
+size_t DB::usedMemory() const {
+    size_t bytes = 0;
+    for (size_t i = 0; i < shardCount(); i++) {
+        bytes += shards_[i].table.nodeBytes() + shards_[i].table.tableBytes()
+               + shards_[i].expiryBytes.load(std::memory_order_relaxed);
+    }
+    return bytes;
+}
+
+size_t DB::updatePeakMemory() {
+    size_t used = usedMemory();
+    size_t peak = peakMemory_.load(std::memory_order_relaxed);
+    while (used > peak && !peakMemory_.compare_exchange_weak(peak, used, std::memory_order_relaxed)) {}
+    return used;
+}
+
+std::optional<size_t> DB::memoryUsage(std::string_view key) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    const KeyNode* node = peek(shard, key, hash);
+    if (!node) return std::nullopt;
+    // its slot pointer and control byte
+    return node->memoryUsage() + sizeof(KeyNode*) + sizeof(uint8_t);
+}
+
+DB::MemoryStats DB::memoryStats() {
+    MemoryStats stats{};
+    stats.used = updatePeakMemory();
+    stats.peak = peakMemory_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < shardCount(); i++) {
+        Shard& shard = shards_[i];
+        stats.dataset += shard.table.nodeBytes();
+        stats.tables += shard.table.tableBytes();
+        stats.expires += shard.expiryBytes.load(std::memory_order_relaxed);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        stats.keys += shard.table.size();
+    }
+
+    // resident pages are the second field of statm
+    std::ifstream statm("/proc/self/statm");
+    size_t totalPages = 0;
+    size_t residentPages = 0;
+    if (statm >> totalPages >> residentPages) {
+        stats.rss = residentPages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 heap = mallinfo2();
+    stats.allocated = heap.uordblks + heap.hblkhd;
+    stats.active = heap.arena + heap.hblkhd;
+#endif
+    SlabAllocator::Stats slab = SlabAllocator::stats();
+    stats.slabReserved = slab.reserved;
+    stats.slabFree = slab.centralFree;
+    return stats;
+}
+
+std::string DB::infoMemory() {
+    MemoryStats stats = memoryStats();
+    auto ratio = [](size_t numerator, size_t denominator) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.2f", denominator ? static_cast<double>(numerator) / denominator : 0.0);
+        return std::string(text);
+    };
+
+    std::string info = "# Memory\r\n";
+    info += "used_memory:" + std::to_string(stats.used) + "\r\n";
+    info += "used_memory_human:" + bytesToHuman(stats.used) + "\r\n";
+    info += "used_memory_peak:" + std::to_string(stats.peak) + "\r\n";
+    info += "used_memory_peak_human:" + bytesToHuman(stats.peak) + "\r\n";
+    info += "used_memory_dataset:" + std::to_string(stats.dataset) + "\r\n";
+    info += "used_memory_overhead:" + std::to_string(stats.tables + stats.expires) + "\r\n";
+    info += "used_memory_rss:" + std::to_string(stats.rss) + "\r\n";
+    info += "used_memory_rss_human:" + bytesToHuman(stats.rss) + "\r\n";
+    info += "allocator_allocated:" + std::to_string(stats.allocated) + "\r\n";
+    info += "allocator_active:" + std::to_string(stats.active) + "\r\n";
+    info += "allocator_frag_ratio:" + ratio(stats.active, stats.allocated) + "\r\n";
+    info += "slab_reserved:" + std::to_string(stats.slabReserved) + "\r\n";
+    info += "slab_free:" + std::to_string(stats.slabFree) + "\r\n";
+    info += "mem_fragmentation_ratio:" + ratio(stats.rss, stats.used) + "\r\n";
+    info += "maxmemory:" + std::to_string(maxMemory_) + "\r\n";
+    info += "maxmemory_human:" + bytesToHuman(maxMemory_) + "\r\n";
+    info += "maxmemory_policy:" + std::string(evictionPolicyName(evictionPolicy_)) + "\r\n";
+    return info;
+}
+
+uint32_t DB::lruClock() {
+    return static_cast<uint32_t>(ServerClock::monotonicMs() / LRU_CLOCK_RESOLUTION_MS);
+}
+
+// counter after the idle periods since its last decrement have been taken off
+uint32_t DB::lfuDecayedCounter(uint32_t access) {
+    uint32_t minutes = static_cast<uint32_t>(ServerClock::monotonicMs() / 60000) & 0xFFFF;
+    uint32_t elapsed = (minutes - (access >> 8)) & 0xFFFF;  // wraps after ~45 days, like Redis
+    uint32_t periods = elapsed / LFU_DECAY_MINUTES;
+    uint32_t counter = access & 0xFF;
+    return periods > counter ? 0 : counter - periods;
+}
+
+KeyNode* DB::newNode(uint64_t hash, std::string_view key, Entry entry) const {
+    KeyNode* node = new KeyNode{hash, SlabString(key), std::move(entry)};
+    if (evictionPolicy_ == EvictionPolicy::AllKeysLfu) {
+        uint32_t minutes = static_cast<uint32_t>(ServerClock::monotonicMs() / 60000) & 0xFFFF;
+        node->access.store(minutes << 8 | LFU_INIT_VAL, std::memory_order_relaxed);
+    } else {
+        node->access.store(lruClock(), std::memory_order_relaxed);
+    }
+    return node;
+}
+
+// Runs on every lookup, lock-free reads included: a relaxed store to the node the reader
+// is looking at anyway, skipped when nothing changed, so hot keys don't bounce the line.
+void DB::touch(const KeyNode& node) const {
+    switch (evictionPolicy_) {
+    case EvictionPolicy::AllKeysLru:
+    case EvictionPolicy::VolatileLru: {
+        uint32_t now = lruClock();
+        if (node.access.load(std::memory_order_relaxed) != now) {
+            node.access.store(now, std::memory_order_relaxed);
+        }
+        break;
+    }
+    case EvictionPolicy::AllKeysLfu: {
+        // logarithmic counter: the higher it is, the less likely an access bumps it
+        uint32_t counter = lfuDecayedCounter(node.access.load(std::memory_order_relaxed));
+        if (counter < 255) {
+            double base = counter > LFU_INIT_VAL ? counter - LFU_INIT_VAL : 0;
+            double chance = 1.0 / (base * LFU_LOG_FACTOR + 1);
+            if (static_cast<double>(randomBits() >> 11) * 0x1.0p-53 < chance) counter++;
+        }
+        uint32_t minutes = static_cast<uint32_t>(ServerClock::monotonicMs() / 60000) & 0xFFFF;
+        uint32_t access = minutes << 8 | counter;
+        if (node.access.load(std::memory_order_relaxed) != access) {
+            node.access.store(access, std::memory_order_relaxed);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+uint64_t DB::evictionScore(const KeyNode& node) const {
+    switch (evictionPolicy_) {
+    case EvictionPolicy::AllKeysLfu:
+        return 255 - lfuDecayedCounter(node.access.load(std::memory_order_relaxed));
+    case EvictionPolicy::VolatileTtl:
+        return UINT64_MAX - static_cast<uint64_t>(node.entry.expireAt);  // soonest first
+    default:
+        return static_cast<uint32_t>(lruClock() - node.access.load(std::memory_order_relaxed));  // idle time
+    }
+}
+
+void DB::sampleForEviction(Shard& shard) {
+    auto offer = [this](const KeyNode& node) {
+        uint64_t score = evictionScore(node);
+        auto& pool = evictionPool_;
+        if (pool.size() == EVICTION_POOL_SIZE && score <= pool.front().score) return;
+        for (const auto& candidate : pool) {
+            if (candidate.hash == node.hash && candidate.key == node.key) return;
+        }
+        auto pos = std::upper_bound(pool.begin(), pool.end(), score,
+            [](uint64_t value, const EvictionCandidate& candidate) { return value < candidate.score; });
+        pool.insert(pos, EvictionCandidate{score, node.hash, node.key});
+        if (pool.size() > EVICTION_POOL_SIZE) pool.erase(pool.begin());
+    };
+
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    if (evictionPolicy_ == EvictionPolicy::VolatileLru || evictionPolicy_ == EvictionPolicy::VolatileTtl) {
+        // the expiry index holds every TTL key (plus stale entries, which are skipped)
+        const auto& heap = shard.expiries;
+        for (size_t i = 0; i < EVICTION_SAMPLES && !heap.empty(); i++) {
+            const ExpiryEntry& entry = heap[randomBits() % heap.size()];
+            const KeyNode* node = shard.table.find(entry.key, entry.hash);
+            if (node && node->entry.expireAt == entry.expireAt) offer(*node);
+        }
+    } else {
+        shard.table.sample(randomBits(), EVICTION_SAMPLES, offer);
+    }
+}
+
+bool DB::evictToLimit(std::vector<std::string>& evicted) {
+    if (evictionPolicy_ == EvictionPolicy::NoEviction) return !overMemoryLimit();
+    bool volatileOnly = evictionPolicy_ == EvictionPolicy::VolatileLru || evictionPolicy_ == EvictionPolicy::VolatileTtl;
+
+    std::lock_guard<std::mutex> evictionLock(evictionMutex_);
+    while (overMemoryLimit()) {
+        for (size_t i = 0; i < shardCount(); i++) {
+            sampleForEviction(shards_[i]);
+        }
+
+        // best first; candidates may have been deleted, or lost their TTL, since they were sampled
+        bool evictedOne = false;
+        while (!evictedOne && !evictionPool_.empty()) {
+            EvictionCandidate candidate = std::move(evictionPool_.back());
+            evictionPool_.pop_back();
+            Shard& shard = shardFor(candidate.hash);
+            std::lock_guard<std::shared_mutex> lock(shard.mutex);
+            KeyNode* node = shard.table.find(candidate.key, candidate.hash);
+            if (!node || (volatileOnly && node->entry.expireAt == Entry::NO_EXPIRY)) continue;
+            shard.table.erase(candidate.key, candidate.hash);
+            evictedKeys_.fetch_add(1, std::memory_order_relaxed);
+            evicted.emplace_back(candidate.key);
+            evictedOne = true;
+        }
+        if (!evictedOne) return false;  // nothing the policy may evict
+    }
+    return true;
+}
+
+// write string to stream:    length stringS
+void DB::writeString(std::ostream &out, std::string_view s) {
     uint64_t length = s.size();
     out.write(reinterpret_cast<const char*>(&length), sizeof(length));
     out.write(s.data(), length);
 }
 
-// read string from ifstream
+// read string from stream
 // get length (first space delimited item)
 // then read that length of chars next for the string
-std::string DB::readString(std::ifstream &in) {
+std::string DB::readString(std::istream &in) {
     uint64_t length = 0;
     in.read(reinterpret_cast<char*>(&length), sizeof(length));
-    std::string s(length, '\0');
-    in.read(&s[0], length);
+    if (!in) return {};  // truncated or foreign file; caller checks stream state
+    if (length > MAX_RDB_STRING) {
+        in.setstate(std::ios::failbit);
+        return {};
+    }
+    // grow as the bytes actually arrive, so a garbage length runs into the end of the
+    // input instead of allocating all of it up front
+    std::string s;
+    while (s.size() < length) {
+        size_t chunk = std::min<uint64_t>(length - s.size(), RDB_READ_CHUNK);
+        size_t at = s.size();
+        s.resize(at + chunk);
+        if (!in.read(&s[at], chunk)) return {};
+    }
     return s;
 }
 
@@ -45,54 +496,115 @@ bool DB::saveRDB(const std::string& fileName) {
         std::cerr << "Failed to open dump.rdb for saving." << std::endl;
         return false;
     }
-    
+    writeRDB(out);
+    std::cout << "DB saved to dump.rdb" << std::endl;
+    return true;
+}
+
+std::string DB::snapshotRDB() {
+    std::ostringstream out(std::ios::binary);
+    writeRDB(out);
+    return std::move(out).str();
+}
+
+void DB::writeRDB(std::ostream& out) {
+    auto locks = readLockAllShards();  // point-in-time snapshot; readers carry on meanwhile
+
+    // file keeps all strings first, then all lists, hashes and sorted sets, each section
+    // prefixed by its count
+    uint64_t numStrings = 0;
+    uint64_t numLists = 0;
+    uint64_t numHashes = 0;
+    uint64_t numSortedSets = 0;
+    for (size_t i = 0; i < shardCount(); i++) {
+        shards_[i].table.forEach([&](const KeyNode& node) {
+            if (node.entry.isString()) numStrings++;
+            else if (node.entry.isList()) numLists++;
+            else if (node.entry.isHash()) numHashes++;
+            else numSortedSets++;
+        });
+    }
+
     // for strings
-    {
-        std::scoped_lock strLock(stringMutex_, expireMutex_);  // avoids deadlocks + nested locks
-        uint64_t numStrings = stringStore_.size();
-        out.write(reinterpret_cast<const char*>(&numStrings), sizeof(numStrings));
-        for (const auto& pair : stringStore_) {
-            // Write key and value using length-prefixed format.
-            writeString(out, pair.first);
-            writeString(out, pair.second);
-            
+    out.write(reinterpret_cast<const char*>(&numStrings), sizeof(numStrings));
+    for (size_t i = 0; i < shardCount(); i++) {
+        shards_[i].table.forEach([&](const KeyNode& node) {
+            const auto* value = std::get_if<StringValue>(&node.entry.value);
+            if (!value) return;
+            // Write key and value using length-prefixed format (integers as their text).
+            writeString(out, node.key);
+            writeString(out, value->str());
+
             // Write expiration (if any). Use -1 to indicate no expiration.
-            int64_t expiration = -1;
-            if (expirationStore_.find(pair.first) != expirationStore_.end())
-                expiration = expirationStore_[pair.first];
+            int64_t expiration = node.entry.expireAt;
             out.write(reinterpret_cast<const char*>(&expiration), sizeof(expiration));
-        }
+        });
     }
-    
+
     // for lists
-    {
-        std::scoped_lock strLock(listMutex_, expireMutex_);  // avoids deadlocks + nested locks
-        uint64_t numLists = listStore_.size();
-        out.write(reinterpret_cast<const char*>(&numLists), sizeof(numLists));
-        for (const auto& pair : listStore_) {
+    out.write(reinterpret_cast<const char*>(&numLists), sizeof(numLists));
+    for (size_t i = 0; i < shardCount(); i++) {
+        shards_[i].table.forEach([&](const KeyNode& node) {
+            const auto* list = std::get_if<QuickList>(&node.entry.value);
+            if (!list) return;
             // Write key using length-prefixed format.
-            writeString(out, pair.first);
-            
+            writeString(out, node.key);
+
             // Write number of elements in the list.
-            uint64_t numElements = pair.second.size();
+            uint64_t numElements = list->size();
             out.write(reinterpret_cast<const char*>(&numElements), sizeof(numElements));
-            
+
             // Write each list element.
-            for (const auto &element : pair.second) {
+            list->forEach([&](std::string_view element) {
                 writeString(out, element);
-            }
-            
+            });
+
             // Write expiration for this key; -1 means no expiration.
-            int64_t expiration = -1;
-           
-            if (expirationStore_.find(pair.first) != expirationStore_.end())
-                expiration = expirationStore_[pair.first];
+            int64_t expiration = node.entry.expireAt;
+            out.write(reinterpret_cast<const char*>(&expiration), sizeof(expiration));
+        });
+    }
+
+    // for hashes: key, field count, then field and value for each, then expiration
+    out.write(reinterpret_cast<const char*>(&numHashes), sizeof(numHashes));
+    for (size_t i = 0; i < shardCount(); i++) {
+        shards_[i].table.forEach([&](const KeyNode& node) {
+            const auto* fields = std::get_if<HashValue>(&node.entry.value);
+            if (!fields) return;
+            writeString(out, node.key);
 
+            uint64_t numFields = fields->size();
+            out.write(reinterpret_cast<const char*>(&numFields), sizeof(numFields));
+            fields->forEach([&](std::string_view field, std::string_view value) {
+                writeString(out, field);
+                writeString(out, value);
+            });
+
+            int64_t expiration = node.entry.expireAt;
             out.write(reinterpret_cast<const char*>(&expiration), sizeof(expiration));
-        }
+        });
+    }
+
+    // for sorted sets: key, member count, then each member and its score (8 raw bytes) in
+    // order, then expiration
+    out.write(reinterpret_cast<const char*>(&numSortedSets), sizeof(numSortedSets));
+    for (size_t i = 0; i < shardCount(); i++) {
+        shards_[i].table.forEach([&](const KeyNode& node) {
+            const auto* zset = std::get_if<SortedSet>(&node.entry.value);
+            if (!zset) return;
+            writeString(out, node.key);
+
+            uint64_t numMembers = zset->size();
+            out.write(reinterpret_cast<const char*>(&numMembers), sizeof(numMembers));
+            zset->forRange(0, zset->size() - 1, [&](std::string_view member, double score) {
+                writeString(out, member);
+                out.write(reinterpret_cast<const char*>(&score), sizeof(score));
+            });
+
+            int64_t expiration = node.entry.expireAt;
+            out.write(reinterpret_cast<const char*>(&expiration), sizeof(expiration));
+        });
     }
-    std::cout << "DB saved to dump.rdb" << std::endl;
-    return true;
 }
 
 // Load the database state to dump.rdb
@@ -102,275 +614,818 @@ bool DB::loadRDB(const std::string& fileName) {
         std::cerr << "No RDB file found, starting with an empty DB." << std::endl;
         return false;
     }
-    
+    if (!readRDB(in)) {
+        std::cerr << fileName << " is truncated or corrupt; only the keys before the damage were loaded." << std::endl;
+        return false;
+    }
+    std::cout << "DB loaded from " << fileName << std::endl;
+    return true;
+}
+
+bool DB::readRDB(std::istream& in) {
+    auto insertLoaded = [this](std::string&& key, Entry&& entry) {
+        uint64_t hash = KeyHash{}(key);
+        KeyNode* node = newNode(hash, key, std::move(entry));
+        Shard& shard = shardFor(hash);
+        std::lock_guard<std::shared_mutex> lock(shard.mutex);
+        shard.table.insert(node);
+        trackExpiry(shard, *node);
+    };
+    // a section count may be missing altogether (older files end early) but not cut short
+    auto readCount = [&in](uint64_t& count) {
+        count = 0;
+        in.read(reinterpret_cast<char*>(&count), sizeof(count));
+        return in || in.gcount() == 0;
+    };
+
     // for strings
-    {
-        std::scoped_lock strLock(stringMutex_, expireMutex_);  // avoids deadlocks + nested locks
-        uint64_t numStrings = 0;
-        in.read(reinterpret_cast<char*>(&numStrings), sizeof(numStrings));
-        for (uint64_t i = 0; i < numStrings; ++i) {
-            std::string key = readString(in);  // read length, then length of that for key
+    uint64_t numStrings = 0;
+    if (!readCount(numStrings)) return false;
+    for (uint64_t i = 0; i < numStrings && in; ++i) {
+        std::string key = readString(in);  // read length, then length of that for key
+        std::string value = readString(in);
+        int64_t expiration;
+        in.read(reinterpret_cast<char*>(&expiration), sizeof(expiration));
+        if (!in) return false;
+
+        insertLoaded(std::move(key), Entry{StringValue(value), expiration});
+    }
+
+    // for lists
+    uint64_t numLists = 0;
+    if (!readCount(numLists)) return false;
+    for (uint64_t i = 0; i < numLists && in; ++i) {
+        std::string key = readString(in);  // read length, then length of that for key
+
+        // Read number of list elements.
+        uint64_t numElements = 0;
+        in.read(reinterpret_cast<char*>(&numElements), sizeof(numElements));
+
+        QuickList elements;
+        for (uint64_t j = 0; j < numElements && in; ++j) {
+            elements.pushBack(readString(in));
+        }
+
+        int64_t expiration;
+        in.read(reinterpret_cast<char*>(&expiration), sizeof(expiration));
+        if (!in) return false;
+
+        insertLoaded(std::move(key), Entry{std::move(elements), expiration});
+    }
+
+    // for hashes; files written before hashes existed end here, leaving the count at 0
+    uint64_t numHashes = 0;
+    if (!readCount(numHashes)) return false;
+    for (uint64_t i = 0; i < numHashes && in; ++i) {
+        std::string key = readString(in);
+
+        uint64_t numFields = 0;
+        in.read(reinterpret_cast<char*>(&numFields), sizeof(numFields));
+
+        HashValue fields;
+        for (uint64_t j = 0; j < numFields && in; ++j) {
+            std::string field = readString(in);
             std::string value = readString(in);
-            int64_t expiration;
-            in.read(reinterpret_cast<char*>(&expiration), sizeof(expiration));
-            
-            stringStore_[key] = value;
-            if (expiration != -1) {
-                expirationStore_[key] = expiration;
-            }
+            fields.set(field, value);
         }
+
+        int64_t expiration;
+        in.read(reinterpret_cast<char*>(&expiration), sizeof(expiration));
+        if (!in) return false;
+
+        insertLoaded(std::move(key), Entry{std::move(fields), expiration});
     }
-    // for lists
-    {
-        std::scoped_lock strLock(listMutex_, expireMutex_);  // avoids deadlocks + nested locks
-        uint64_t numLists = 0;
-        in.read(reinterpret_cast<char*>(&numLists), sizeof(numLists));
-        for (uint64_t i = 0; i < numLists; ++i) {
-            std::string key = readString(in);  // read length, then length of that for key
-            
-            // Read number of list elements.
-            uint64_t numElements = 0;
-            in.read(reinterpret_cast<char*>(&numElements), sizeof(numElements));
-            
-            std::vector<std::string> elements;
-            for (uint64_t j = 0; j < numElements; ++j) {
-                std::string element = readString(in);
-                elements.push_back(element);
-            }
-            
-            int64_t expiration;
-            in.read(reinterpret_cast<char*>(&expiration), sizeof(expiration));
-            
-            listStore_[key] = elements;
-            if (expiration != -1) {
-                expirationStore_[key] = expiration;
-            }
+
+    // for sorted sets; absent from files written before they existed
+    uint64_t numSortedSets = 0;
+    if (!readCount(numSortedSets)) return false;
+    for (uint64_t i = 0; i < numSortedSets && in; ++i) {
+        std::string key = readString(in);
+
+        uint64_t numMembers = 0;
+        in.read(reinterpret_cast<char*>(&numMembers), sizeof(numMembers));
+
+        SortedSet zset;
+        for (uint64_t j = 0; j < numMembers && in; ++j) {
+            std::string member = readString(in);
+            double score = 0;
+            in.read(reinterpret_cast<char*>(&score), sizeof(score));
+            zset.set(member, score);
         }
-        return true;
+
+        int64_t expiration;
+        in.read(reinterpret_cast<char*>(&expiration), sizeof(expiration));
+        if (!in) return false;
+
+        insertLoaded(std::move(key), Entry{std::move(zset), expiration});
     }
-    std::cout << "DB loaded from dump.rdb" << std::endl;
+    return true;
 }
 
-// check if expired and erase if so, then throw error
-void DB::throwDeleteIfExpired(const std::string& key) {
-    if (isExpired(key)) {
-        erase(key);
-        throw std::runtime_error("Key has expired");
+KeyNode* DB::lookup(Shard& shard, std::string_view key, uint64_t hash, bool* expired) {
+    if (expired) *expired = false;
+    KeyNode* node = shard.table.find(key, hash);
+    if (!node) return nullptr;
+
+    if (node->entry.expiredAt(ServerClock::nowMs())) {
+        shard.table.erase(key, hash);
+        expiredKeys_.fetch_add(1, std::memory_order_relaxed);
+        if (expired) *expired = true;
+        return nullptr;
     }
+    touch(*node);
+    return node;
 }
 
-// check Is Expired
-bool DB::isExpired(const std::string& key) {
-    std::lock_guard<std::mutex> lock(expireMutex_);
-    auto it = expirationStore_.find(key);
-    if (it == expirationStore_.end()) return false;
-    auto now = std::chrono::system_clock::now();
+const KeyNode* DB::peek(const Shard& shard, std::string_view key, uint64_t hash, bool* expired) const {
+    if (expired) *expired = false;
+    const KeyNode* node = shard.table.find(key, hash);
+    if (!node) return nullptr;
 
-    auto unixTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+    if (node->entry.expiredAt(ServerClock::nowMs())) {
+        if (expired) *expired = true;
+        return nullptr;
+    }
+    touch(*node);
+    return node;
+}
 
-    return unixTimeMs > it->second;
+void DB::removeIfExpired(Shard& shard, std::string_view key, uint64_t hash) {
+    std::lock_guard<std::shared_mutex> lock(shard.mutex);
+    lookup(shard, key, hash);  // re-checks: a writer may have replaced the key since we looked
 }
-void DB::setExpirationTime(const std::string& key, long expiry) {
-    std::lock_guard<std::mutex> lock(expireMutex_);
-    expirationStore_[key] = expiry;
+
+void DB::set(std::string_view key, std::string_view value, long long expireAt) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    // built before taking the lock; readers see either the old node or this one, never a mix
+    KeyNode* node = newNode(hash, key, Entry{StringValue(value), expireAt});
+
+    std::lock_guard<std::shared_mutex> lock(shard.mutex);
+    shard.table.insert(node);  // always overwrites, whatever the old type
+    trackExpiry(shard, *node);
 }
 
-// set expiration as infinite
-void DB::setExpirationInf(const std::string& key) {
-    std::lock_guard<std::mutex> lock(expireMutex_);
-    expirationStore_.erase(key);
+// lock-free: no shard lock, just an epoch guard while the node is read
+std::optional<std::string> DB::get(std::string_view key) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    {
+        EpochGuard guard;
+        bool expired = false;
+        const KeyNode* node = peek(shard, key, hash, &expired);
+        if (!expired) {
+            if (!node) return std::nullopt;   // does not exist; send null string
+
+            auto* str = std::get_if<StringValue>(&node->entry.value);
+            if (!str) {
+                throw std::runtime_error(WRONGTYPE);
+            }
+            return str->str();
+        }
+    }
+    removeIfExpired(shard, key, hash);
+    // better to have error than null string; OG redis has null string but that is not descriptive
+    throw std::runtime_error("Key has expired");
 }
 
-void DB::set(const std::string& key, const std::string& value) {
-    std::scoped_lock strLock(stringMutex_, listMutex_);  // avoids deadlocks
+bool DB::exist(std::string_view key) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    {
+        EpochGuard guard;
+        bool expired = false;
+        if (peek(shard, key, hash, &expired)) return true;
+        if (!expired) return false;
+    }
+    removeIfExpired(shard, key, hash);
+    return false;
+}
 
-    // always overwrites
-    listStore_.erase(key);
+bool DB::erase(std::string_view key) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::lock_guard<std::shared_mutex> lock(shard.mutex);
+    return shard.table.erase(key, hash);
+}
 
-    stringStore_[key] = value;
+std::vector<DB::BatchKey> DB::batchByShard(std::span<const std::string_view> args, size_t stride) const {
+    std::vector<BatchKey> batch;
+    batch.reserve((args.size() + stride - 1) / stride);
+    for (size_t i = 0; i < args.size(); i += stride) {
+        uint64_t hash = KeyHash{}(args[i]);
+        batch.push_back({args[i], hash, i, shardIndex(hash)});
+    }
+    std::stable_sort(batch.begin(), batch.end(),
+                     [](const BatchKey& a, const BatchKey& b) { return a.shard < b.shard; });
+    return batch;
+}
+
+template <typename Fn>
+void DB::forEachShardRun(const std::vector<BatchKey>& batch, Fn&& fn) {
+    for (size_t begin = 0; begin < batch.size();) {
+        size_t end = begin + 1;
+        while (end < batch.size() && batch[end].shard == batch[begin].shard) end++;
 
+        Shard& shard = shards_[batch[begin].shard];
+        std::lock_guard<std::shared_mutex> lock(shard.mutex);
+        for (size_t i = begin; i < std::min(end, begin + PREFETCH_DISTANCE); i++) {
+            shard.table.prefetch(batch[i].hash);
+        }
+        for (size_t i = begin; i < end; i++) {
+            if (i + PREFETCH_DISTANCE < end) shard.table.prefetch(batch[i + PREFETCH_DISTANCE].hash);
+            fn(shard, batch[i]);
+        }
+        begin = end;
+    }
 }
 
-std::string DB::get(const std::string& key) {
+template <typename Fn>
+void DB::peekEach(std::span<const std::string_view> keys, Fn&& fn) {
+    std::vector<uint64_t> hashes(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) hashes[i] = KeyHash{}(keys[i]);
+
+    std::vector<size_t> expired;
     {
-        std::lock_guard<std::mutex> strLock(stringMutex_);
-        auto it = stringStore_.find(key);
-        if (it != stringStore_.end()) {
-            return it->second;
+        EpochGuard guard;
+        for (size_t i = 0; i < std::min(keys.size(), PREFETCH_DISTANCE); i++) {
+            shardFor(hashes[i]).table.prefetch(hashes[i]);
+        }
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (i + PREFETCH_DISTANCE < keys.size()) {
+                uint64_t ahead = hashes[i + PREFETCH_DISTANCE];
+                shardFor(ahead).table.prefetch(ahead);
+            }
+            bool wasExpired = false;
+            fn(i, peek(shardFor(hashes[i]), keys[i], hashes[i], &wasExpired));
+            if (wasExpired) expired.push_back(i);
         }
     }
-    {
-        std::lock_guard<std::mutex> listLock(listMutex_);
-        if (listStore_.find(key) != listStore_.end()) {
-            throw std::runtime_error("WRONGTYPE Operation against a key holding the wrong kind of value");
+    for (size_t i : expired) removeIfExpired(shardFor(hashes[i]), keys[i], hashes[i]);
+}
+
+std::vector<std::optional<std::string>> DB::mget(std::span<const std::string_view> keys) {
+    std::vector<std::optional<std::string>> values(keys.size());
+    peekEach(keys, [&values](size_t i, const KeyNode* node) {
+        if (!node) return;
+        // MGET answers nil for other types rather than failing the whole batch
+        if (auto* str = std::get_if<StringValue>(&node->entry.value)) values[i] = str->str();
+    });
+    return values;
+}
+
+void DB::mset(std::span<const std::string_view> keysAndValues) {
+    std::vector<BatchKey> batch = batchByShard(keysAndValues, 2);
+    // as in set(), nodes are built before any lock is taken
+    std::vector<KeyNode*> nodes(keysAndValues.size() / 2);
+    for (const BatchKey& key : batch) {
+        nodes[key.index / 2] = newNode(key.hash, key.key, Entry{StringValue(keysAndValues[key.index + 1])});
+    }
+    forEachShardRun(batch, [&nodes](Shard& shard, const BatchKey& key) {
+        shard.table.insert(nodes[key.index / 2]);
+    });
+}
+
+size_t DB::exist(std::span<const std::string_view> keys) {
+    size_t found = 0;
+    peekEach(keys, [&found](size_t, const KeyNode* node) {
+        if (node) found++;
+    });
+    return found;
+}
+
+size_t DB::erase(std::span<const std::string_view> keys) {
+    size_t erased = 0;
+    forEachShardRun(batchByShard(keys, 1), [&erased](Shard& shard, const BatchKey& key) {
+        if (shard.table.erase(key.key, key.hash)) erased++;
+    });
+    return erased;
+}
+
+int64_t DB::incrBy(std::string_view key, int64_t delta) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::lock_guard<std::shared_mutex> lock(shard.mutex);
+    bool expired = false;
+    KeyNode* node = lookup(shard, key, hash, &expired);
+    if (expired) throw std::runtime_error("Key has expired");
+
+    int64_t num = 0;
+    long long expireAt = Entry::NO_EXPIRY;
+    if (node) {
+        auto* str = std::get_if<StringValue>(&node->entry.value);
+        if (!str) {
+            throw std::runtime_error(WRONGTYPE);
+        }
+        // every string that reads as an int64 is stored int-encoded, so nothing to parse
+        if (!str->isInteger()) {
+            throw std::runtime_error("value is not an integer or out of range");
         }
+        num = str->integer();
+        expireAt = node->entry.expireAt;
     }
-    return "$-1\r\n";   // does not exist; send null string
+    if (__builtin_add_overflow(num, delta, &num)) {
+        throw std::runtime_error("increment or decrement would overflow");
+    }
+    // strings are immutable once published, so the new value goes in a new node
+    shard.table.insert(newNode(hash, key, Entry{StringValue::fromInteger(num), expireAt}));
+    return num;
 }
 
-bool DB::exist(const std::string& key) {
-    // check if exists as string or list
-    {
-        std::lock_guard<std::mutex> strLock(stringMutex_);
-        if (stringStore_.find(key) != stringStore_.end())
-            return true;
+size_t DB::lpush(std::string_view key, std::span<const std::string_view> values) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::lock_guard<std::shared_mutex> lock(shard.mutex);
+    KeyNode* node = lookup(shard, key, hash);
+    if (!node) {
+        // get key's value or create new list if it does not exist
+        node = newNode(hash, key, Entry{QuickList{}});
+        shard.table.insert(node);
     }
-    {
-        std::lock_guard<std::mutex> listLock(listMutex_);
-        if (listStore_.find(key) != listStore_.end())
-            return true;
+    auto* list = std::get_if<QuickList>(&node->entry.value);
+    if (!list) {
+        throw std::runtime_error(WRONGTYPE);
     }
-    return false;
+    // inserted one by one, so the final order is reversed relative to the command order
+    size_t bytesBefore = list->bytes();
+    for (std::string_view value : values) {
+        list->pushFront(value);
+    }
+    shard.table.nodeResized(static_cast<ptrdiff_t>(list->bytes() - bytesBefore));
+    return list->size();
 }
 
-bool DB::erase(const std::string& key) {
-    bool deleted = false;
-    {
-        std::lock_guard<std::mutex> strLock(stringMutex_);
-        if (stringStore_.erase(key) > 0) {
-            deleted = true;
-        }
+size_t DB::rpush(std::string_view key, std::span<const std::string_view> values) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::lock_guard<std::shared_mutex> lock(shard.mutex);
+    KeyNode* node = lookup(shard, key, hash);
+    if (!node) {
+        node = newNode(hash, key, Entry{QuickList{}});
+        shard.table.insert(node);
     }
-    {
-        std::lock_guard<std::mutex> listLock(listMutex_);
-        if (listStore_.erase(key) > 0) {
-            deleted = true;
-        }
+    auto* list = std::get_if<QuickList>(&node->entry.value);
+    if (!list) {
+        throw std::runtime_error(WRONGTYPE);
     }
-    return deleted;
+    size_t bytesBefore = list->bytes();
+    for (std::string_view value : values) {
+        list->pushBack(value);
+    }
+    shard.table.nodeResized(static_cast<ptrdiff_t>(list->bytes() - bytesBefore));
+    return list->size();
 }
 
-int DB::incr(const std::string& key) {
-    {
-        std::lock_guard<std::mutex> listLock(listMutex_);
-        if (listStore_.find(key) != listStore_.end()) {
-            throw std::runtime_error("WRONGTYPE Operation against a key holding the wrong kind of value");
-        }
+std::vector<std::string> DB::popList(std::string_view key, size_t count, bool fromHead) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::lock_guard<std::shared_mutex> lock(shard.mutex);
+    KeyNode* node = lookup(shard, key, hash);
+    if (!node) return {};
+    auto* list = std::get_if<QuickList>(&node->entry.value);
+    if (!list) {
+        throw std::runtime_error(WRONGTYPE);
     }
-    std::lock_guard<std::mutex> strLock(stringMutex_);
-    auto it = stringStore_.find(key);
-    if (it == stringStore_.end()) {
-        stringStore_[key] = "1";
-        return 1;
+
+    std::vector<std::string> popped;
+    popped.reserve(std::min(count, list->size()));
+    size_t bytesBefore = list->bytes();
+    while (popped.size() < count && !list->empty()) {
+        popped.push_back(*(fromHead ? list->popFront() : list->popBack()));
     }
-    int num = 0;
-    try {
-        num = std::stoi(it->second);
-    } catch (...) {
-        throw std::runtime_error("Value is not an integer");
+    shard.table.nodeResized(-static_cast<ptrdiff_t>(bytesBefore - list->bytes()));
+    if (list->empty()) {
+        shard.table.erase(key, hash);  // like Redis, a list never exists empty
     }
-    num++;
-    it->second = std::to_string(num);
-    return num;
+    return popped;
 }
 
-int DB::decr(const std::string& key) {
-    {
-        std::lock_guard<std::mutex> listLock(listMutex_);
-        if (listStore_.find(key) != listStore_.end()) {
-            throw std::runtime_error("WRONGTYPE Operation against a key holding the wrong kind of value");
-        }
+std::vector<std::string> DB::lpop(std::string_view key, size_t count) {
+    return popList(key, count, true);
+}
+
+std::vector<std::string> DB::rpop(std::string_view key, size_t count) {
+    return popList(key, count, false);
+}
+
+size_t DB::llen(std::string_view key) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    const KeyNode* node = peek(shard, key, hash);
+    if (!node) return 0;
+    auto* list = std::get_if<QuickList>(&node->entry.value);
+    if (!list) {
+        throw std::runtime_error(WRONGTYPE);
+    }
+    return list->size();
+}
+
+std::optional<std::string> DB::lindex(std::string_view key, long long index) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    const KeyNode* node = peek(shard, key, hash);
+    if (!node) return std::nullopt;
+    auto* list = std::get_if<QuickList>(&node->entry.value);
+    if (!list) {
+        throw std::runtime_error(WRONGTYPE);
     }
-    std::lock_guard<std::mutex> strLock(stringMutex_);
-    auto it = stringStore_.find(key);
-    if (it == stringStore_.end()) {
-        stringStore_[key] = "-1";
-        return -1;
+    long long size = static_cast<long long>(list->size());
+    if (index < 0) index += size;
+    if (index < 0 || index >= size) return std::nullopt;
+    return list->at(static_cast<size_t>(index));
+}
+
+void DB::ltrim(std::string_view key, long long start, long long stop) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::lock_guard<std::shared_mutex> lock(shard.mutex);
+    KeyNode* node = lookup(shard, key, hash);
+    if (!node) return;
+    auto* list = std::get_if<QuickList>(&node->entry.value);
+    if (!list) {
+        throw std::runtime_error(WRONGTYPE);
     }
-    int num = 0;
-    try {
-        num = std::stoi(it->second);
-    } catch (...) {
-        throw std::runtime_error("Value is not an integer");
+
+    long long size = static_cast<long long>(list->size());
+    if (start < 0) start = std::max(size + start, 0LL);
+    if (stop < 0) stop += size;
+    if (stop >= size) stop = size - 1;
+    if (start > stop || start >= size) {
+        shard.table.erase(key, hash);  // nothing left
+        return;
     }
-    num--;
-    it->second = std::to_string(num);
-    return num;
+    size_t bytesBefore = list->bytes();
+    list->dropBack(static_cast<size_t>(size - 1 - stop));
+    list->dropFront(static_cast<size_t>(start));
+    shard.table.nodeResized(-static_cast<ptrdiff_t>(bytesBefore - list->bytes()));
 }
 
-void DB::lpush(const std::string& key, const std::string& value) {
-    // Check that the key is not in the string store with temporary lock.
-    {
-        std::lock_guard<std::mutex> strLock(stringMutex_);
-        if (stringStore_.find(key) != stringStore_.end()) {
-            throw std::runtime_error("WRONGTYPE Operation against a key holding the wrong kind of value");
-        }
+size_t DB::sizeOf(std::string_view key) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    const KeyNode* node = peek(shard, key, hash);
+    if (!node) return 0; // 0 if does not exist
+
+    // return size of string, list, hash or sorted set
+    if (auto* str = std::get_if<StringValue>(&node->entry.value)) {
+        return str->size();
     }
-    // get key's value and append or create new list if it does not exist
-    std::lock_guard<std::mutex> listLock(listMutex_);
-    auto it = listStore_.find(key);
-    if (it == listStore_.end()) {
-        listStore_[key] = std::vector<std::string>{ value };
-    } else {
-        it->second.insert(it->second.begin(), value);
+    if (auto* fields = std::get_if<HashValue>(&node->entry.value)) {
+        return fields->size();
+    }
+    if (auto* zset = std::get_if<SortedSet>(&node->entry.value)) {
+        return zset->size();
     }
+    return std::get<QuickList>(node->entry.value).size();
 }
 
-size_t DB::sizeOf(const std::string& key) {
-    // return size of string
-    {
-        std::lock_guard<std::mutex> strLock(stringMutex_);
-        auto it = stringStore_.find(key);
-        if (it != stringStore_.end()) {
-            return it->second.size();
-        }
+std::vector<std::string> DB::lrange(std::string_view key, long long start, long long stop) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    // shared lock rather than an epoch guard: lists change in place under the exclusive lock.
+    // expired lists are left for the next write to delete
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    const KeyNode* node = peek(shard, key, hash);
+    if (!node) {
+        return {};
+    }
+    auto* listPtr = std::get_if<QuickList>(&node->entry.value);
+    if (!listPtr) {
+        throw std::runtime_error(WRONGTYPE);
     }
 
-    // return size of list
-    {
-        std::lock_guard<std::mutex> listLock(listMutex_);
-        auto it = listStore_.find(key);
-        if (it != listStore_.end()) {
-            return it->second.size();
+    const auto& list = *listPtr;
+    long long size = static_cast<long long>(list.size());
+
+    // negative values are idx relative from end, just like python does; the range is then
+    // clamped to the list, so out-of-range bounds of any magnitude select nothing or all of it
+    if (start < 0) start = std::max(size + start, 0LL);
+    if (stop < 0) stop += size;
+    if (stop >= size) stop = size - 1;
+    if (start > stop) return {}; // invalid range
+
+    std::vector<std::string> snippet;
+    snippet.reserve(static_cast<size_t>(stop - start + 1));
+    list.forRange(static_cast<size_t>(start), static_cast<size_t>(stop),
+                  [&snippet](std::string_view element) { snippet.emplace_back(element); });
+    return snippet;
+}
+
+size_t DB::hset(std::string_view key, std::span<const std::string_view> fieldsAndValues) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::lock_guard<std::shared_mutex> lock(shard.mutex);
+    KeyNode* node = lookup(shard, key, hash);
+    if (!node) {
+        node = newNode(hash, key, Entry{HashValue{}});
+        shard.table.insert(node);
+    }
+    auto* fields = std::get_if<HashValue>(&node->entry.value);
+    if (!fields) {
+        throw std::runtime_error(WRONGTYPE);
+    }
+    size_t bytesBefore = fields->bytes();
+    size_t added = 0;
+    for (size_t i = 0; i + 1 < fieldsAndValues.size(); i += 2) {
+        if (fields->set(fieldsAndValues[i], fieldsAndValues[i + 1])) added++;
+    }
+    shard.table.nodeResized(static_cast<ptrdiff_t>(fields->bytes()) - static_cast<ptrdiff_t>(bytesBefore));
+    return added;
+}
+
+std::optional<std::string> DB::hget(std::string_view key, std::string_view field) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    // shared lock, as for lists: hashes change in place
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    const KeyNode* node = peek(shard, key, hash);
+    if (!node) return std::nullopt;
+    auto* fields = std::get_if<HashValue>(&node->entry.value);
+    if (!fields) {
+        throw std::runtime_error(WRONGTYPE);
+    }
+    std::optional<std::string_view> value = fields->get(field);
+    if (!value) return std::nullopt;
+    return std::string(*value);
+}
+
+std::vector<std::optional<std::string>> DB::hmget(std::string_view key, std::span<const std::string_view> fields) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    std::vector<std::optional<std::string>> values(fields.size());
+    const KeyNode* node = peek(shard, key, hash);
+    if (!node) return values;
+    auto* hashValue = std::get_if<HashValue>(&node->entry.value);
+    if (!hashValue) {
+        throw std::runtime_error(WRONGTYPE);
+    }
+    for (size_t i = 0; i < fields.size(); i++) {
+        if (std::optional<std::string_view> value = hashValue->get(fields[i])) values[i] = std::string(*value);
+    }
+    return values;
+}
+
+size_t DB::hdel(std::string_view key, std::span<const std::string_view> fields) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::lock_guard<std::shared_mutex> lock(shard.mutex);
+    KeyNode* node = lookup(shard, key, hash);
+    if (!node) return 0;
+    auto* hashValue = std::get_if<HashValue>(&node->entry.value);
+    if (!hashValue) {
+        throw std::runtime_error(WRONGTYPE);
+    }
+    size_t bytesBefore = hashValue->bytes();
+    size_t removed = 0;
+    for (std::string_view field : fields) {
+        if (hashValue->erase(field)) removed++;
+    }
+    shard.table.nodeResized(static_cast<ptrdiff_t>(hashValue->bytes()) - static_cast<ptrdiff_t>(bytesBefore));
+    if (hashValue->empty()) {
+        shard.table.erase(key, hash);  // like lists, a hash never exists empty
+    }
+    return removed;
+}
+
+std::vector<std::string> DB::hgetall(std::string_view key) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    const KeyNode* node = peek(shard, key, hash);
+    if (!node) return {};
+    auto* fields = std::get_if<HashValue>(&node->entry.value);
+    if (!fields) {
+        throw std::runtime_error(WRONGTYPE);
+    }
+    std::vector<std::string> flat;
+    flat.reserve(2 * fields->size());
+    fields->forEach([&flat](std::string_view field, std::string_view value) {
+        flat.emplace_back(field);
+        flat.emplace_back(value);
+    });
+    return flat;
+}
+
+int64_t DB::hincrBy(std::string_view key, std::string_view field, int64_t delta) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::lock_guard<std::shared_mutex> lock(shard.mutex);
+    KeyNode* node = lookup(shard, key, hash);
+    if (node && !node->entry.isHash()) {
+        throw std::runtime_error(WRONGTYPE);
+    }
+
+    int64_t num = 0;
+    if (node) {
+        if (std::optional<std::string_view> current = std::get<HashValue>(node->entry.value).get(field)) {
+            const char* end = current->data() + current->size();
+            auto [parsed, error] = std::from_chars(current->data(), end, num);
+            if (current->empty() || error != std::errc{} || parsed != end) {
+                throw std::runtime_error("hash value is not an integer");
+            }
         }
     }
-    return 0; // 0 if does not exist
+    if (__builtin_add_overflow(num, delta, &num)) {
+        throw std::runtime_error("increment or decrement would overflow");
+    }
+
+    if (!node) {
+        node = newNode(hash, key, Entry{HashValue{}});
+        shard.table.insert(node);
+    }
+    auto& fields = std::get<HashValue>(node->entry.value);
+    size_t bytesBefore = fields.bytes();
+    fields.set(field, std::to_string(num));
+    shard.table.nodeResized(static_cast<ptrdiff_t>(fields.bytes()) - static_cast<ptrdiff_t>(bytesBefore));
+    return num;
 }
 
+size_t DB::hlen(std::string_view key) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    const KeyNode* node = peek(shard, key, hash);
+    if (!node) return 0;
+    auto* fields = std::get_if<HashValue>(&node->entry.value);
+    if (!fields) {
+        throw std::runtime_error(WRONGTYPE);
+    }
+    return fields->size();
+}
 
-void DB::rpush(const std::string& key, const std::string& value) {
-    // Check that the key is not in the string store.
-    {
-        std::lock_guard<std::mutex> strLock(stringMutex_);
-        if (stringStore_.find(key) != stringStore_.end()) {
-            throw std::runtime_error("WRONGTYPE Operation against a key holding the wrong kind of value");
+size_t DB::zadd(std::string_view key, std::span<const std::pair<double, std::string_view>> members, uint32_t flags) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::lock_guard<std::shared_mutex> lock(shard.mutex);
+    KeyNode* node = lookup(shard, key, hash);
+    if (!node) {
+        if (flags & ZADD_XX) return 0;  // nothing to update, and XX never creates
+        node = newNode(hash, key, Entry{SortedSet{}});
+        shard.table.insert(node);
+    }
+    auto* zset = std::get_if<SortedSet>(&node->entry.value);
+    if (!zset) {
+        throw std::runtime_error(WRONGTYPE);
+    }
+
+    size_t bytesBefore = zset->bytes();
+    size_t added = 0;
+    size_t updated = 0;
+    for (const auto& [score, member] : members) {
+        std::optional<double> current = zset->score(member);
+        if (!current) {
+            if (flags & ZADD_XX) continue;
+            zset->set(member, score);
+            added++;
+            continue;
         }
+        if (flags & ZADD_NX) continue;
+        if (*current == score) continue;
+        if ((flags & ZADD_GT) && score < *current) continue;
+        if ((flags & ZADD_LT) && score > *current) continue;
+        zset->set(member, score);
+        updated++;
     }
-    // get key's value and append or create new list if it does not exist
-    std::lock_guard<std::mutex> listLock(listMutex_);
-    auto it = listStore_.find(key);
-    if (it == listStore_.end()) {
-        listStore_[key] = std::vector<std::string>{ value };
-    } else {
-        it->second.push_back(value);
+    shard.table.nodeResized(static_cast<ptrdiff_t>(zset->bytes()) - static_cast<ptrdiff_t>(bytesBefore));
+    return (flags & ZADD_CH) ? added + updated : added;
+}
+
+std::optional<double> DB::zincrBy(std::string_view key, std::string_view member, double increment, uint32_t flags) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::lock_guard<std::shared_mutex> lock(shard.mutex);
+    KeyNode* node = lookup(shard, key, hash);
+    if (node && !node->entry.isSortedSet()) {
+        throw std::runtime_error(WRONGTYPE);
+    }
+
+    std::optional<double> current;
+    if (node) current = std::get<SortedSet>(node->entry.value).score(member);
+    if (current ? (flags & ZADD_NX) : (flags & ZADD_XX)) return std::nullopt;
+    double score = current.value_or(0) + increment;
+    if (std::isnan(score)) {
+        throw std::runtime_error("resulting score is not a number (NaN)");
+    }
+    if (current && (((flags & ZADD_GT) && score < *current) || ((flags & ZADD_LT) && score > *current))) {
+        return std::nullopt;
     }
+
+    if (!node) {
+        node = newNode(hash, key, Entry{SortedSet{}});
+        shard.table.insert(node);
+    }
+    auto& zset = std::get<SortedSet>(node->entry.value);
+    size_t bytesBefore = zset.bytes();
+    zset.set(member, score);
+    shard.table.nodeResized(static_cast<ptrdiff_t>(zset.bytes()) - static_cast<ptrdiff_t>(bytesBefore));
+    return score;
 }
 
-std::vector<std::string> DB::lrange(const std::string& key, int start, int stop) {
-    std::lock_guard<std::mutex> listLock(listMutex_);
-    auto it = listStore_.find(key);
-    if (it == listStore_.end()) {
-        return {};
+size_t DB::zrem(std::string_view key, std::span<const std::string_view> members) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::lock_guard<std::shared_mutex> lock(shard.mutex);
+    KeyNode* node = lookup(shard, key, hash);
+    if (!node) return 0;
+    auto* zset = std::get_if<SortedSet>(&node->entry.value);
+    if (!zset) {
+        throw std::runtime_error(WRONGTYPE);
     }
+    size_t bytesBefore = zset->bytes();
+    size_t removed = 0;
+    for (std::string_view member : members) {
+        if (zset->erase(member)) removed++;
+    }
+    shard.table.nodeResized(static_cast<ptrdiff_t>(zset->bytes()) - static_cast<ptrdiff_t>(bytesBefore));
+    if (zset->empty()) {
+        shard.table.erase(key, hash);  // like lists, a sorted set never exists empty
+    }
+    return removed;
+}
 
-    const auto& list = it->second;
-    int size = static_cast<int>(list.size());
+std::optional<double> DB::zscore(std::string_view key, std::string_view member) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    const KeyNode* node = peek(shard, key, hash);
+    if (!node) return std::nullopt;
+    auto* zset = std::get_if<SortedSet>(&node->entry.value);
+    if (!zset) {
+        throw std::runtime_error(WRONGTYPE);
+    }
+    return zset->score(member);
+}
 
-    // set negative values as idx relative from end, just like python does
-    if (start < 0) {
-        start = size + start;
-        if (start < 0) start = 0; // clamping in case size is not big enough
+std::optional<size_t> DB::zrank(std::string_view key, std::string_view member) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    const KeyNode* node = peek(shard, key, hash);
+    if (!node) return std::nullopt;
+    auto* zset = std::get_if<SortedSet>(&node->entry.value);
+    if (!zset) {
+        throw std::runtime_error(WRONGTYPE);
     }
+    return zset->rank(member);
+}
 
-    // negative values are idx relative from end
-    if (stop < 0) {
-        stop = size + stop;
-        if (stop < 0) stop = 0; // clamping so stop is not out of bounds
+size_t DB::zcard(std::string_view key) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    const KeyNode* node = peek(shard, key, hash);
+    if (!node) return 0;
+    auto* zset = std::get_if<SortedSet>(&node->entry.value);
+    if (!zset) {
+        throw std::runtime_error(WRONGTYPE);
     }
+    return zset->size();
+}
 
-    // end clamping relative to end
+std::vector<std::pair<std::string, double>> DB::zrange(std::string_view key, long long start, long long stop) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    const KeyNode* node = peek(shard, key, hash);
+    if (!node) return {};
+    auto* zset = std::get_if<SortedSet>(&node->entry.value);
+    if (!zset) {
+        throw std::runtime_error(WRONGTYPE);
+    }
+
+    // same clamping as LRANGE
+    long long size = static_cast<long long>(zset->size());
+    if (start < 0) start = std::max(size + start, 0LL);
+    if (stop < 0) stop += size;
     if (stop >= size) stop = size - 1;
-    if (start > stop) return {}; // invalid range
+    if (start > stop) return {};
 
-    return std::vector<std::string>(list.begin() + start, list.begin() + stop + 1);
-}
\ No newline at end of file
+    std::vector<std::pair<std::string, double>> members;
+    members.reserve(static_cast<size_t>(stop - start + 1));
+    zset->forRange(static_cast<size_t>(start), static_cast<size_t>(stop), [&members](std::string_view member, double score) {
+        members.emplace_back(member, score);
+    });
+    return members;
+}
+
+std::vector<std::pair<std::string, double>> DB::zrangeByScore(std::string_view key, const SortedSet::ScoreRange& range,
+                                                                  size_t offset, size_t limit) {
+    uint64_t hash = KeyHash{}(key);
+    Shard& shard = shardFor(hash);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    const KeyNode* node = peek(shard, key, hash);
+    if (!node) return {};
+    auto* zset = std::get_if<SortedSet>(&node->entry.value);
+    if (!zset) {
+        throw std::runtime_error(WRONGTYPE);
+    }
+    std::vector<std::pair<std::string, double>> members;
+    zset->forScoreRange(range, offset, limit, [&members](std::string_view member, double score) {
+        members.emplace_back(member, score);
+    });
+    return members;
+}
@@ -1,90 +1,360 @@
 #ifndef DB_HPP
 #define DB_HPP
 
-#include <unordered_map>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <optional>
+#include <span>
 #include <stdexcept>
 #include <mutex>
+#include <shared_mutex>
+#include <memory>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include "KeyTable.hpp"
 
 class DB {
 public:
+    static constexpr size_t DEFAULT_SHARDS = 16;
+
     // Get the singleton instance.
     static DB& getInstance();
 
+    // Number of keyspace shards (rounded up to a power of two). Only takes effect if
+    // called before the first getInstance(), i.e. while parsing the command line.
+    static void setShardCount(size_t count);
+    size_t shardCount() const { return shardMask_ + 1; }
+
     DB(const DB&) = delete;
     DB& operator=(const DB&) = delete;
 
-    // Set a key to a string value.
-    // Throws if the key already holds a list.
-    void set(const std::string& key, const std::string& value);
+    // Set a key to a string value, replacing whatever it held (list included).
+    // expireAt is a unix timestamp in ms; NO_EXPIRY clears any TTL.
+    void set(std::string_view key, std::string_view value, long long expireAt = Entry::NO_EXPIRY);
+
+    // Get the string value of a key; nullopt if it does not exist.
+    // Throws if the key holds a list or has just expired.
+    std::optional<std::string> get(std::string_view key);
 
-    // Get the string value of a key.
-    // Throws if the key does not exist or if the key holds a list.
-    std::string get(const std::string& key);
+    // Check if a key exists (expired keys are deleted and don't count).
+    bool exist(std::string_view key);
 
-    // Check if a key exists (in either store).
-    bool exist(const std::string& key);
+    // Erase (delete) a key of any type.
+    bool erase(std::string_view key);
 
-    // Erase (delete) a key from both stores.
-    bool erase(const std::string& key);
+    // Multi-key forms (MGET, MSET, EXISTS, DEL). Keys are hashed up front and the table
+    // slots of the next few are prefetched while the current one is handled, so a batch
+    // overlaps its cache misses instead of taking them one after another. Writers group
+    // the keys by shard and take each shard's lock once.
 
-    // Increment the numeric value stored at key.
-    // If key doesn't exist, set it to "1".
-    int incr(const std::string& key);
+    // One value per key: nullopt for keys that are missing, expired or not strings.
+    std::vector<std::optional<std::string>> mget(std::span<const std::string_view> keys);
+    // key, value, key, value, ...: set each without a TTL; a repeated key keeps its last value.
+    void mset(std::span<const std::string_view> keysAndValues);
+    // How many of keys exist, a repeated key counting each time.
+    size_t exist(std::span<const std::string_view> keys);
+    // How many of keys were erased.
+    size_t erase(std::span<const std::string_view> keys);
 
-    // Decrement the numeric value stored at key.
-    // If key doesn't exist, set it to "-1".
-    int decr(const std::string& key);
+    // Add delta to the integer stored at key (INCR/DECR/INCRBY/DECRBY), treating a missing
+    // key as 0 and keeping any TTL. Throws if the value is not an int64 or would overflow.
+    int64_t incrBy(std::string_view key, int64_t delta);
 
-    // Push a value onto the head of a list.
-    // If key does not exist, a new list is created.
-    // Throws if the key holds a string.
-    void lpush(const std::string& key, const std::string& value);
+    // Push values one by one onto the head of a list, creating it if needed.
+    // Throws if the key holds a string. Returns the new length.
+    size_t lpush(std::string_view key, std::span<const std::string_view> values);
 
-    // Push a value onto the tail of a list.
-    // If key does not exist, a new list is created.
-    // Throws if the key holds a string.
-    void rpush(const std::string& key, const std::string& value);
+    // Push values onto the tail of a list, creating it if needed.
+    // Throws if the key holds a string. Returns the new length.
+    size_t rpush(std::string_view key, std::span<const std::string_view> values);
 
     // Return a subset of the list stored at key, between start and stop (inclusive).
-    std::vector<std::string> lrange(const std::string& key, int start, int stop);
+    // Negative indexes count from the tail; bounds are clamped to the list.
+    std::vector<std::string> lrange(std::string_view key, long long start, long long stop);
+
+    // Pop up to count elements from the head (lpop) or tail (rpop) of a list, in pop order.
+    // Empty if the key does not exist; a list emptied by the pop is deleted.
+    std::vector<std::string> lpop(std::string_view key, size_t count = 1);
+    std::vector<std::string> rpop(std::string_view key, size_t count = 1);
+
+    // Length of the list at key; 0 if it does not exist. Throws if the key holds a string.
+    size_t llen(std::string_view key);
+
+    // Element at index (negative counts from the tail); nullopt if out of range or missing.
+    std::optional<std::string> lindex(std::string_view key, long long index);
+
+    // Keep only elements start..stop (inclusive, negative counts from the tail); a list
+    // trimmed to nothing is deleted.
+    void ltrim(std::string_view key, long long start, long long stop);
+
+    // Set fields of the hash at key (field, value, field, value, ...), creating it if
+    // needed. Throws if the key holds another type. Returns how many fields were new.
+    size_t hset(std::string_view key, std::span<const std::string_view> fieldsAndValues);
+
+    // Value of one field; nullopt if the field or the key is missing.
+    std::optional<std::string> hget(std::string_view key, std::string_view field);
+
+    // One value per field, nullopt where missing.
+    std::vector<std::optional<std::string>> hmget(std::string_view key, std::span<const std::string_view> fields);
+
+    // Remove fields, returning how many existed; a hash left empty is deleted.
+    size_t hdel(std::string_view key, std::span<const std::string_view> fields);
+
+    // Every field and value, flattened: field, value, field, value, ...
+    std::vector<std::string> hgetall(std::string_view key);
 
-    // get size of string/list. 0 if does not exist
-    size_t sizeOf(const std::string& key);
+    // Add delta to the integer in field, treating a missing field as 0. Throws if the
+    // value is not an int64 or would overflow. Returns the new value.
+    int64_t hincrBy(std::string_view key, std::string_view field, int64_t delta);
 
-    // delete entry then throw if expired
-    void throwDeleteIfExpired(const std::string& key);
-    
-    // check if expired (used by above function)
-    bool isExpired(const std::string& key);
+    // Number of fields in the hash at key; 0 if it does not exist.
+    size_t hlen(std::string_view key);
 
-    // set time of expiry
-    void setExpirationTime(const std::string& key, long expiry);
-    
-    //set it as infinite (remove)
-    void setExpirationInf(const std::string& key);
+    // ZADD conditions, as in Redis: NX only adds, XX only updates, GT/LT only move a score
+    // up/down, CH counts updated members in the reply too
+    enum ZAddFlags : uint32_t {
+        ZADD_NX = 1 << 0,
+        ZADD_XX = 1 << 1,
+        ZADD_GT = 1 << 2,
+        ZADD_LT = 1 << 3,
+        ZADD_CH = 1 << 4,
+    };
+
+    // Add (score, member) pairs to the sorted set at key, creating it unless ZADD_XX.
+    // Throws if the key holds another type. Returns how many were added (with ZADD_CH,
+    // added or updated).
+    size_t zadd(std::string_view key, std::span<const std::pair<double, std::string_view>> members, uint32_t flags = 0);
+
+    // Add increment to member's score, a missing member counting as 0 (ZINCRBY, ZADD INCR).
+    // Returns the new score, or nullopt if flags ruled the change out. Throws if the
+    // result is not a number.
+    std::optional<double> zincrBy(std::string_view key, std::string_view member, double increment, uint32_t flags = 0);
+
+    // Remove members, returning how many existed; a set left empty is deleted.
+    size_t zrem(std::string_view key, std::span<const std::string_view> members);
+
+    // Score of member; nullopt if the member or the key is missing.
+    std::optional<double> zscore(std::string_view key, std::string_view member);
+
+    // 0-based position of member by ascending score; nullopt if missing.
+    std::optional<size_t> zrank(std::string_view key, std::string_view member);
+
+    // Number of members; 0 if the key does not exist.
+    size_t zcard(std::string_view key);
+
+    // Members at ranks start..stop (inclusive, negative counts from the end) with scores.
+    std::vector<std::pair<std::string, double>> zrange(std::string_view key, long long start, long long stop);
+
+    // Members whose score is in range, in order, skipping offset and returning at most limit.
+    std::vector<std::pair<std::string, double>> zrangeByScore(std::string_view key, const SortedSet::ScoreRange& range,
+                                                              size_t offset, size_t limit);
+
+    // get size of string/list/hash/sorted set. 0 if does not exist
+    size_t sizeOf(std::string_view key);
 
     bool loadRDB(const std::string& fileName = "dump.rdb");
     bool saveRDB(const std::string& fileName = "dump.rdb");
+    // the same dump, in memory: what a master sends a replica on full resync
+    std::string snapshotRDB();
+
+    // Periodic housekeeping, run by one event loop every CRON_INTERVAL_MS: deletes keys whose
+    // TTL has passed and moves tables that are mid-rehash along, each within a time budget.
+    void cron();
+
+    // "# Stats" section for INFO: expired_keys, expired_stale_perc, evicted_keys, ...
+    std::string infoStats() const;
+
+    // What to drop once used memory passes the --maxmemory limit
+    enum class EvictionPolicy { NoEviction, AllKeysLru, AllKeysLfu, VolatileLru, VolatileTtl };
+
+    // --maxmemory / --maxmemory-policy; 0 bytes means no limit. Set while parsing the
+    // command line, before any client is served.
+    static void setMaxMemory(size_t bytes, EvictionPolicy policy);
+    // "allkeys-lru" etc.; nullopt for unknown names
+    static std::optional<EvictionPolicy> parseEvictionPolicy(std::string_view name);
+
+    // Bytes held by the keyspace: nodes with their keys and values, the shard tables and
+    // the expiry index. Maintained on every write, so this is a sum of a few counters.
+    size_t usedMemory() const;
+    bool overMemoryLimit() const { return maxMemory_ != 0 && usedMemory() > maxMemory_; }
+
+    // Evict keys picked by the policy until used memory is back under the limit, appending
+    // their names to evicted so the caller can propagate the deletions. False if it can't
+    // get there: noeviction, or nothing left that the policy may evict.
+    bool evictToLimit(std::vector<std::string>& evicted);
+
+    // MEMORY USAGE: bytes held for key (node, key, value and its table slot); nullopt if missing.
+    std::optional<size_t> memoryUsage(std::string_view key);
+
+    struct MemoryStats {
+        size_t used;       // usedMemory()
+        size_t peak;       // highest used seen by cron or a stats call
+        size_t dataset;    // nodes: keys and values
+        size_t tables;     // shard slot arrays
+        size_t expires;    // expiry index
+        size_t keys;
+        size_t rss;        // process resident set, 0 if unknown
+        size_t allocated;  // in use according to malloc, 0 if unknown
+        size_t active;     // held by malloc from the OS, 0 if unknown
+        size_t slabReserved;  // slab allocator: slabs taken from malloc
+        size_t slabFree;      // slab allocator: chunks free on its central lists
+    };
+    MemoryStats memoryStats();
+
+    // "# Memory" section for INFO: used_memory, used_memory_peak, fragmentation, maxmemory, ...
+    std::string infoMemory();
+
+    static constexpr int CRON_INTERVAL_MS = 100;
 private:
+    static constexpr auto CRON_REHASH_BUDGET = std::chrono::milliseconds(1);
+    static constexpr size_t CRON_REHASH_BATCH = 100;  // nodes moved per shard lock hold
+    // like Redis's slow cycle: at most a quarter of each cron interval goes to expiring keys
+    static constexpr auto CRON_EXPIRE_BUDGET = std::chrono::milliseconds(CRON_INTERVAL_MS / 4);
+    static constexpr size_t CRON_EXPIRE_BATCH = 64;   // due index entries handled per shard lock hold
+    static constexpr size_t STALE_SCAN_LIMIT = 10000; // overdue index entries counted per shard
+
+    // Redis's approximated LRU/LFU: each round samples a few keys per shard into a small
+    // pool of the best candidates seen so far, then evicts the best one still present.
+    static constexpr size_t EVICTION_SAMPLES = 5;       // keys sampled per shard per round
+    static constexpr size_t EVICTION_POOL_SIZE = 16;
+    static constexpr uint32_t LRU_CLOCK_RESOLUTION_MS = 1000;
+    // LFU access clock: last decrement time in minutes (16 bits) << 8 | log counter (8 bits)
+    static constexpr uint32_t LFU_INIT_VAL = 5;         // new keys start here, not at 0, so they get a chance
+    static constexpr double LFU_LOG_FACTOR = 10;
+    static constexpr uint32_t LFU_DECAY_MINUTES = 1;    // counter loses 1 per idle period
+
     DB();
     ~DB();
 
-    // one for string values, one for list values.
-    std::unordered_map<std::string, std::string> stringStore_;
-    std::unordered_map<std::string, std::vector<std::string>> listStore_;
-    std::unordered_map<std::string, long long> expirationStore_;
+    // One key's TTL in a shard's expiry index. Entries are not removed when the key is
+    // deleted or given a new TTL; they are dropped as stale when they come due.
+    struct ExpiryEntry {
+        long long expireAt;
+        uint64_t hash;
+        SlabString key;
+
+        bool operator>(const ExpiryEntry& other) const { return expireAt > other.expireAt; }
+    };
+
+    // A slice of the keyspace. Its table is read without locks (strings: GET, EXISTS)
+    // inside an EpochGuard; writers take the lock exclusively, so writers to different
+    // shards never contend. List and hash reads take it shared, since those change in place.
+    // Aligned so neighbouring shards' locks don't share a cache line.
+    struct alignas(64) Shard {
+        KeyTable table;
+        std::shared_mutex mutex;
+        std::vector<ExpiryEntry> expiries;  // min-heap on expireAt; modified under the exclusive lock only
+        size_t expiryKeyBytes = 0;          // heap bytes of the entries' keys
+        std::atomic<size_t> expiryBytes{0}; // whole index, republished after each change
+    };
+
+    static size_t requestedShards_;
+    static size_t maxMemory_;
+    static EvictionPolicy evictionPolicy_;
+
+    std::unique_ptr<Shard[]> shards_;
+    size_t shardMask_;
+    size_t expireCursor_ = 0;  // shard the next active expire cycle starts from (cron thread only)
+
+    std::atomic<uint64_t> expiredKeys_{0};      // deleted for expiry, lazily or actively
+    std::atomic<uint64_t> expireCycleTimeCapped_{0};
+    std::atomic<double> expiredStalePerc_{0};   // smoothed % of TTL keys found overdue after a cycle
+    std::atomic<uint64_t> evictedKeys_{0};
+    std::atomic<size_t> peakMemory_{0};
+
+    struct EvictionCandidate {
+        uint64_t score;  // higher is evicted first
+        uint64_t hash;
+        SlabString key;
+    };
+    std::mutex evictionMutex_;                      // one evicting thread at a time
+    std::vector<EvictionCandidate> evictionPool_;   // ascending score; under evictionMutex_
+
+    // keys map to shards by the top bits of their hash; tables probe from the low bits
+    size_t shardIndex(uint64_t hash) const { return (hash >> 32) & shardMask_; }
+    Shard& shardFor(uint64_t hash) {
+        return shards_[shardIndex(hash)];
+    }
+
+    static constexpr size_t PREFETCH_DISTANCE = 4;  // keys ahead of the one being handled
+
+    // a batch key with its hash, where it sits in the command's args, and its shard
+    struct BatchKey {
+        std::string_view key;
+        uint64_t hash;
+        size_t index;
+        size_t shard;
+    };
+    // args[0], args[stride], ... hashed and stably sorted by shard, so repeated keys keep
+    // their command order
+    std::vector<BatchKey> batchByShard(std::span<const std::string_view> args, size_t stride) const;
+    // call fn(shard, key) for each batch key, under its shard's exclusive lock, which is
+    // taken once per run of keys in that shard
+    template <typename Fn>
+    void forEachShardRun(const std::vector<BatchKey>& batch, Fn&& fn);
+    // lock-free pass over keys in command order (MGET, EXISTS): fn(i, node), node null when
+    // missing or expired; expired keys are removed afterwards
+    template <typename Fn>
+    void peekEach(std::span<const std::string_view> keys, Fn&& fn);
+
+    // For whole-keyspace reads (saveRDB): takes every shard lock shared, in index order,
+    // the only order in which more than one is ever held.
+    std::vector<std::shared_lock<std::shared_mutex>> readLockAllShards();
+
+    // Find key in shard, lazily deleting it if its TTL has passed. Caller holds shard.mutex
+    // exclusively. expired (optional) reports whether a lookup miss was due to expiry.
+    KeyNode* lookup(Shard& shard, std::string_view key, uint64_t hash, bool* expired = nullptr);
+
+    // Read-only lookup, for callers in an EpochGuard or holding shard.mutex shared: an
+    // expired key is reported through expired but left in place, since deleting is a write.
+    const KeyNode* peek(const Shard& shard, std::string_view key, uint64_t hash, bool* expired = nullptr) const;
+
+    // Delete key if it is (still) expired; takes shard.mutex exclusively.
+    void removeIfExpired(Shard& shard, std::string_view key, uint64_t hash);
 
-    mutable std::mutex stringMutex_;
-    mutable std::mutex listMutex_;
-    mutable std::mutex expireMutex_;
+    // Add node's TTL, if any, to the shard's expiry index. Caller holds shard.mutex exclusively.
+    void trackExpiry(Shard& shard, const KeyNode& node);
+    // Pop up to limit due entries from shard's index, deleting the keys they still describe;
+    // sets more if due entries remain.
+    // Caller holds shard.mutex exclusively.
+    size_t expireDue(Shard& shard, long long now, size_t limit, bool& more);
+    // Fresh node with its access clock stamped for the eviction policy.
+    KeyNode* newNode(uint64_t hash, std::string_view key, Entry entry) const;
+    // Record an access in node's LRU time or LFU counter (nothing without an LRU/LFU policy).
+    void touch(const KeyNode& node) const;
+    // How badly node should go under the policy: idle time, inverted frequency or TTL.
+    uint64_t evictionScore(const KeyNode& node) const;
+    // Offer EVICTION_SAMPLES of shard's keys (TTL keys only for volatile policies) to the
+    // pool. Caller holds evictionMutex_.
+    void sampleForEviction(Shard& shard);
+    static uint32_t lruClock();
+    static uint32_t lfuDecayedCounter(uint32_t access);
 
+    // Store shard's index size in expiryBytes. Caller holds shard.mutex exclusively.
+    static void publishExpiryBytes(Shard& shard);
+    // usedMemory(), raising peakMemory_ if it is a new high
+    size_t updatePeakMemory();
 
-    void writeString(std::ofstream &out, const std::string &s);
-    std::string readString(std::ifstream &in);
+    // Overdue entries left in shard's index, counted up to STALE_SCAN_LIMIT.
+    static size_t countOverdue(const Shard& shard, long long now);
+    void activeExpireCycle();
 
+    // LPOP/RPOP: pop from one end, deleting the key once the list is empty
+    std::vector<std::string> popList(std::string_view key, size_t count, bool fromHead);
 
+    // the dump format behind saveRDB/loadRDB and snapshotRDB
+    void writeRDB(std::ostream& out);
+    // false if the input is cut short or corrupt; whatever came before stays loaded
+    bool readRDB(std::istream& in);
+    void writeString(std::ostream &out, std::string_view s);
+    // Fails the stream, returning "", past the end of the input or on a length over
+    // MAX_RDB_STRING (Redis's default proto-max-bulk-len).
+    std::string readString(std::istream &in);
+    static constexpr uint64_t MAX_RDB_STRING = 512ull * 1024 * 1024;
+    static constexpr size_t RDB_READ_CHUNK = 64 * 1024;
 };
 
 #endif // DB_HPP
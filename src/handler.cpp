@@ -1,256 +1,742 @@
 #include "Handler.hpp"
+#include "BlockingRegistry.hpp"
+#include "command_table.hpp"
 #include <stdexcept>
 #include <string>
 #include <iostream>
 #include <cstdlib>
-#include <sys/socket.h>
-#include <sstream> 
-Handler::Handler()
+#include <charconv>
+#include <climits>
+#include <cmath>
+#include <optional>
+#include <span>
+
+namespace {
+    // arguments are views into the read buffer, so parse them in place rather than via stoll
+    long long parseInteger(std::string_view str) {
+        long long value = 0;
+        auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+        if (ec != std::errc() || ptr != str.data() + str.size()) {
+            throw std::runtime_error("value is not an integer or out of range");
+        }
+        return value;
+    }
+
+    // scores follow strtod: decimal or exponent form, "inf"/"+inf"/"-inf"; NaN is refused
+    double parseScore(std::string_view str) {
+        if (str.size() > 1 && str[0] == '+' && str[1] != '-' && str[1] != '+') {
+            str.remove_prefix(1);  // from_chars takes no leading '+'
+        }
+        double value = 0;
+        auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+        if (ec != std::errc() || ptr != str.data() + str.size() || std::isnan(value)) {
+            throw std::runtime_error("value is not a valid float");
+        }
+        return value;
+    }
+
+    // shortest text that reads back as the same double
+    std::string formatScore(double score) {
+        if (std::isinf(score)) return score > 0 ? "inf" : "-inf";
+        char buffer[32];
+        auto [ptr, ec] = std::to_chars(buffer, buffer + sizeof(buffer), score);
+        return std::string(buffer, ptr);
+    }
+
+    // ZRANGEBYSCORE bound: a score, "(" in front for exclusive
+    double parseScoreBound(std::string_view str, bool& exclusive) {
+        exclusive = !str.empty() && str[0] == '(';
+        if (exclusive) str.remove_prefix(1);
+        try {
+            return parseScore(str);
+        } catch (const std::runtime_error&) {
+            throw std::runtime_error("min or max is not a float");
+        }
+    }
+}
+
+Handler::Handler() : db(&DB::getInstance())
 {
-    DB& db = DB::getInstance();
 }
 
-void Handler::sendErrorMessage(int fd, const std::string& errorMessage) {
-    std::string redisError = "-ERR " + errorMessage + "\r\n";   // -ERR is resp
-    send(fd, redisError.c_str(), redisError.length(), 0);
+void Handler::sendErrorMessage(ReplyBuilder& reply, const std::string& errorMessage) {
+    reply.error("ERR " + errorMessage);   // -ERR is resp
 }
 
-// only expiry-sensitive functions: get, incr, decr, exists. lists cannot expire. only single-values
+// expiry is checked by the DB on every lookup; an expired key is deleted and treated as missing
 
 // Argument format: SET key value expiry
 // expiry is unix timestamp (can be seconds or milliseconds; no relative support for now)
 // Sets value at key, overwriting if applicable. Resets TTL if applicable.
 // Returns OK if successful
-void Handler::handleSet(int fd, const std::vector<RESPElement>& requestArray) {
+void Handler::handleSet(const CommandArgs& args, ReplyBuilder& reply) {
     try {
-        if (requestArray.size() > 4 || requestArray.size() < 2) {
+        if (args.size() > 4 || args.size() < 3) {
             throw std::runtime_error("Invalid SET command format");
         }
 
         // Extract key and value from the request array.
-        std::string key = requestArray[1].value;
-        std::string value = requestArray[2].value;
+        std::string_view key = args[1];
+        std::string_view value = args[2];
 
-        db->set(key, value);
-        if (requestArray.size() == 4)
+        long long expireAt = Entry::NO_EXPIRY;  // set expire time as infinite
+        if (args.size() == 4)
         {
-            std::string timestampStr = requestArray[3].value;
-            long long timestamp = std::stoll(timestampStr);
-            db->setExpirationTime(key, timestamp);
+            expireAt = parseInteger(args[3]);
         }
-        else // set expire time as infinite
-        {
-            db->setExpirationInf(key);
-        }
-        std::string response = "+OK\r\n";
-        send(fd, response.c_str(), response.length(), 0);
+        db->set(key, value, expireAt);
+        reply.simpleString("OK");
     }
     catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
-        sendErrorMessage(fd, e.what());
+        sendErrorMessage(reply, e.what());
     }
 }
 
 // Argument format: GET key
 // returns value at key. returns error otherwise if not string
-void Handler::handleGet(int fd, const std::vector<RESPElement>& requestArray) {
+void Handler::handleGet(const CommandArgs& args, ReplyBuilder& reply) {
     try {
-        if (requestArray.size() != 2) {
+        if (args.size() != 2) {
             throw std::runtime_error("Invalid GET command format");
         }
 
-        std::string key = requestArray[1].value;
-        db->throwDeleteIfExpired(key);  // better to have error than null string
-        // OG redis has null string but that is not descriptive
+        std::string_view key = args[1];
+        // throws if the key just expired: better to have error than null string
+        std::optional<std::string> value = db->get(key);
 
-        std::string value = db->get(key);
+        if (value) {
+            reply.bulkString(*value);
+        } else {
+            reply.nullBulkString();
+        }
 
-        std::string response = "$" + std::to_string(value.length()) + "\r\n" + value + "\r\n";
-        send(fd, response.c_str(), response.length(), 0);
-    
     }
     catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
-        sendErrorMessage(fd, e.what());
+        sendErrorMessage(reply, e.what());
     }
 }
 
 // Argument format: EXISTS key [keys...]
 // Shows if key exists
 // Returns 1 if exists (sums up for each key given, even duplicates)
-void Handler::handleExists(int fd, const std::vector<RESPElement>& requestArray) {
+void Handler::handleExists(const CommandArgs& args, ReplyBuilder& reply) {
     try {
-        if (requestArray.size() != 2) {
-            throw std::runtime_error("Invalid EXISTS command format");
-        }
-
-        std::string key;
-        int num_found = 0;
-        for (size_t i = 1; i < requestArray.size(); i++) {
-            key = requestArray[i].value;
-
-            // delete if expired; don't count as exist
-            try {
-                db->throwDeleteIfExpired(key);
-            } catch (const std::exception& e) {
-                continue;
-            }
-            
-            if (db->exist(key))
-            {
-                num_found++;
-            }
-        }
-        std::string response = ":" + std::to_string(num_found) + "\r\n";
-        send(fd, response.c_str(), response.length(), 0);
+        // expired keys are deleted and don't count as existing
+        size_t num_found = db->exist(std::span(args).subspan(1));
+        reply.integer(static_cast<int64_t>(num_found));
     }
     catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
-        sendErrorMessage(fd, e.what());
+        sendErrorMessage(reply, e.what());
     }
 }
 
 // Argument format: DEL key [keys...]
 // Deletes key value pair. Ignores key if it does not exist
 // Returns number of keys deleted
-void Handler::handleDel(int fd, const std::vector<RESPElement>& requestArray) {
-    try {
-        if (requestArray.size() != 2) {
-            throw std::runtime_error("Invalid DEL command format");
-        }
-        int num_deleted = 0;
-        std::string key;
-        for (size_t i = 1; i < requestArray.size(); i++) {
-            key = requestArray[i].value;
-            if (db->erase(key))
-            {
-                num_deleted++;
+void Handler::handleDel(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        size_t num_deleted = db->erase(std::span(args).subspan(1));
+        reply.integer(static_cast<int64_t>(num_deleted));
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
+    }
+}
+
+// Argument format: MGET key [keys...]
+// Returns an array with the value of each key, nil where the key is missing or not a string
+void Handler::handleMGet(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        std::vector<std::optional<std::string>> values = db->mget(std::span(args).subspan(1));
+        reply.arrayHeader(values.size());
+        for (const auto& value : values) {
+            if (value) {
+                reply.bulkString(*value);
+            } else {
+                reply.nullBulkString();
             }
         }
-        std::string response = ":" + std::to_string(num_deleted) + "\r\n";
-        send(fd, response.c_str(), response.length(), 0);
     }
     catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
-        sendErrorMessage(fd, e.what());
+        sendErrorMessage(reply, e.what());
+    }
+}
+
+// Argument format: MSET key value [key value...]
+// Sets every key to its value, clearing any TTL. Returns OK
+void Handler::handleMSet(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        if (args.size() % 2 == 0) {
+            replyWrongArity(reply, args[0]);
+            return;
+        }
+        db->mset(std::span(args).subspan(1));
+        reply.simpleString("OK");
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
     }
 }
 
 // Argument format: INCR key
 // Increments value by one. Returns error if is not intenger
 // Returns new value of key
-void Handler::handleIncr(int fd, const std::vector<RESPElement>& requestArray) {
+void Handler::handleIncr(const CommandArgs& args, ReplyBuilder& reply) {
     try {
-        if (requestArray.size() != 2) {
+        if (args.size() != 2) {
             throw std::runtime_error("Invalid INCR command format");
         }
 
-        std::string key = requestArray[1].value;
-
-        db->throwDeleteIfExpired(key);
+        std::string_view key = args[1];
 
-        int new_val = db->incr(key);        
+        int64_t new_val = db->incrBy(key, 1);
 
-        std::string response = ":" + std::to_string(new_val) + "\r\n";
-        send(fd, response.c_str(), response.length(), 0);
+        reply.integer(new_val);
     }
     catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
-        sendErrorMessage(fd, e.what());
+        sendErrorMessage(reply, e.what());
     }
 }
 
 // Argument format: DECR key
 // Decrements value by one. Returns error if is not intenger
 // Returns new value of key
-void Handler::handleDecr(int fd, const std::vector<RESPElement>& requestArray) {
+void Handler::handleDecr(const CommandArgs& args, ReplyBuilder& reply) {
     try {
-        if (requestArray.size() != 2) {
+        if (args.size() != 2) {
             throw std::runtime_error("Invalid DECR command format");
         }
 
-        std::string key = requestArray[1].value;
+        std::string_view key = args[1];
+
+        int64_t new_val = db->incrBy(key, -1);
+
+        reply.integer(new_val);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
+    }
+}
+
+// Argument format: INCRBY key increment
+// Adds increment (a signed 64-bit integer) to value. Returns error if is not integer
+// Returns new value of key
+void Handler::handleIncrBy(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        if (args.size() != 3) {
+            throw std::runtime_error("Invalid INCRBY command format");
+        }
 
-        db->throwDeleteIfExpired(key);
+        std::string_view key = args[1];
+        long long increment = parseInteger(args[2]);
 
-        int new_val = db->incr(key);        
+        int64_t new_val = db->incrBy(key, increment);
 
-        std::string response = ":" + std::to_string(new_val) + "\r\n";
-        send(fd, response.c_str(), response.length(), 0);
+        reply.integer(new_val);
     }
     catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
-        sendErrorMessage(fd, e.what());
+        sendErrorMessage(reply, e.what());
+    }
+}
+
+// Argument format: DECRBY key decrement
+// Subtracts decrement from value. Returns error if is not integer
+// Returns new value of key
+void Handler::handleDecrBy(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        if (args.size() != 3) {
+            throw std::runtime_error("Invalid DECRBY command format");
+        }
+
+        std::string_view key = args[1];
+        long long decrement = parseInteger(args[2]);
+        if (decrement == LLONG_MIN) {
+            throw std::runtime_error("decrement would overflow");  // can't be negated
+        }
+
+        int64_t new_val = db->incrBy(key, -decrement);
+
+        reply.integer(new_val);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
     }
 }
 
 // LPUSH key value [value ...]
 // Inserts values at the head (left side) of the list.
 // Returns size of array after changes
-void Handler::handleLPush(int fd, const std::vector<RESPElement>& requestArray) {
+void Handler::handleLPush(const CommandArgs& args, ReplyBuilder& reply) {
     try {
-        if (requestArray.size() < 3) {
+        if (args.size() < 3) {
             throw std::runtime_error("Invalid LPUSH command format");
         }
-        std::string key = requestArray[1].value;
+        std::string_view key = args[1];
         // In Redis, LPUSH inserts values one by one, so the final order is reversed relative to the command order.
-        for (size_t i = 2; i < requestArray.size(); i++) {
-            db->lpush(key, requestArray[i].value);
-        }
-        size_t newLength = db->sizeOf(key);
-        std::string response = ":" + std::to_string(newLength) + "\r\n";
-        send(fd, response.c_str(), response.length(), 0);
+        size_t newLength = db->lpush(key, std::span(args).subspan(2));
+        BlockingRegistry::getInstance().signalKeyReady(key);
+        reply.integer(newLength);
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
-        sendErrorMessage(fd, e.what());
+        sendErrorMessage(reply, e.what());
     }
 }
 
 // RPUSH key value [value ...]
 // Appends values to the tail (right side) of the list.
 // Returns new length of array at key value
-void Handler::handleRPush(int fd, const std::vector<RESPElement>& requestArray) {
+void Handler::handleRPush(const CommandArgs& args, ReplyBuilder& reply) {
     try {
-        if (requestArray.size() < 3) {
+        if (args.size() < 3) {
             throw std::runtime_error("Invalid RPUSH command format");
         }
-        std::string key = requestArray[1].value;
-        for (size_t i = 2; i < requestArray.size(); i++) {  // start after key in command list
-            db->rpush(key, requestArray[i].value);
-        }
-        size_t newLength = db->sizeOf(key);
-        std::string response = ":" + std::to_string(newLength) + "\r\n";
-        send(fd, response.c_str(), response.length(), 0);
+        std::string_view key = args[1];
+        size_t newLength = db->rpush(key, std::span(args).subspan(2));  // start after key in command list
+        BlockingRegistry::getInstance().signalKeyReady(key);
+        reply.integer(newLength);
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
-        sendErrorMessage(fd, e.what());
+        sendErrorMessage(reply, e.what());
     }
 }
 
 // LRANGE key start stop
 // Returns the list elements between indices start and stop (inclusive).
-void Handler::handleLRange(int fd, const std::vector<RESPElement>& requestArray) {
+void Handler::handleLRange(const CommandArgs& args, ReplyBuilder& reply) {
     try {
-        if (requestArray.size() != 4) {
+        if (args.size() != 4) {
             throw std::runtime_error("Invalid LRANGE command format");
         }
-        std::string key = requestArray[1].value;
-        int start = std::stoi(requestArray[2].value);
-        int stop  = std::stoi(requestArray[3].value);
+        std::string_view key = args[1];
+        long long start = parseInteger(args[2]);
+        long long stop  = parseInteger(args[3]);
 
         std::vector<std::string> snippet = db->lrange(key, start, stop);
 
         //resp formatting
-        std::ostringstream response;
-        response << "*" << (stop - start + 1) << "\r\n";
-        for (int i = 0; i < snippet.size(); ++i) {
-            const std::string& value = snippet[i];
-            response << "$" << value.size() << "\r\n" << value << "\r\n"; // Bulk string format
-        }
-        std::string responseStr = response.str();
-        send(fd, responseStr.c_str(), responseStr.length(), 0);
+        reply.arrayHeader(snippet.size());
+        for (const std::string& value : snippet) {
+            reply.bulkString(value);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
+    }
+}
+// LPOP key [count] / RPOP key [count]
+// Without count: the popped element, or nil. With count: an array of up to count
+// elements, or a nil array if the key does not exist.
+void Handler::handlePop(const CommandArgs& args, ReplyBuilder& reply, bool fromHead) {
+    try {
+        if (args.size() != 2 && args.size() != 3) {
+            throw std::runtime_error(fromHead ? "Invalid LPOP command format" : "Invalid RPOP command format");
+        }
+        std::string_view key = args[1];
+        long long count = 1;
+        if (args.size() == 3) {
+            count = parseInteger(args[2]);
+            if (count < 0) {
+                throw std::runtime_error("value is out of range, must be positive");
+            }
+        }
+
+        std::vector<std::string> popped = fromHead ? db->lpop(key, count) : db->rpop(key, count);
+
+        if (args.size() == 2) {
+            if (popped.empty()) reply.nullBulkString();
+            else reply.bulkString(popped.front());
+            return;
+        }
+        if (popped.empty() && count > 0) {
+            reply.nullArray();
+            return;
+        }
+        reply.arrayHeader(popped.size());
+        for (const std::string& value : popped) {
+            reply.bulkString(value);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
+    }
+}
+
+void Handler::handleLPop(const CommandArgs& args, ReplyBuilder& reply) {
+    handlePop(args, reply, true);
+}
+
+void Handler::handleRPop(const CommandArgs& args, ReplyBuilder& reply) {
+    handlePop(args, reply, false);
+}
+
+// LLEN key
+// Returns the length of the list, 0 if key does not exist
+void Handler::handleLLen(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        if (args.size() != 2) {
+            throw std::runtime_error("Invalid LLEN command format");
+        }
+        reply.integer(db->llen(args[1]));
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
+    }
+}
+
+// LINDEX key index
+// Returns the element at index (negative counts from the tail), or nil if out of range
+void Handler::handleLIndex(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        if (args.size() != 3) {
+            throw std::runtime_error("Invalid LINDEX command format");
+        }
+        std::optional<std::string> value = db->lindex(args[1], parseInteger(args[2]));
+        if (value) reply.bulkString(*value);
+        else reply.nullBulkString();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
+    }
+}
+
+// LTRIM key start stop
+// Keeps only elements start..stop (inclusive). Returns OK
+void Handler::handleLTrim(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        if (args.size() != 4) {
+            throw std::runtime_error("Invalid LTRIM command format");
+        }
+        long long start = parseInteger(args[2]);
+        long long stop = parseInteger(args[3]);
+        db->ltrim(args[1], start, stop);
+        reply.simpleString("OK");
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
+    }
+}
+
+// HSET key field value [field value ...]
+// Sets fields of a hash, creating it if needed. Returns how many fields were new
+void Handler::handleHSet(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        if (args.size() % 2 != 0) {
+            replyWrongArity(reply, args[0]);
+            return;
+        }
+        size_t added = db->hset(args[1], std::span(args).subspan(2));
+        reply.integer(static_cast<int64_t>(added));
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
-        sendErrorMessage(fd, e.what());
+        sendErrorMessage(reply, e.what());
     }
-}
\ No newline at end of file
+}
+
+// HGET key field
+// Returns the field's value, or nil if the field or the key does not exist
+void Handler::handleHGet(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        std::optional<std::string> value = db->hget(args[1], args[2]);
+        if (value) reply.bulkString(*value);
+        else reply.nullBulkString();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
+    }
+}
+
+// HMGET key field [field ...]
+// Returns an array with each field's value, nil where missing
+void Handler::handleHMGet(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        std::vector<std::optional<std::string>> values = db->hmget(args[1], std::span(args).subspan(2));
+        reply.arrayHeader(values.size());
+        for (const auto& value : values) {
+            if (value) reply.bulkString(*value);
+            else reply.nullBulkString();
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
+    }
+}
+
+// HDEL key field [field ...]
+// Removes fields, deleting the hash once empty. Returns how many were removed
+void Handler::handleHDel(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        size_t removed = db->hdel(args[1], std::span(args).subspan(2));
+        reply.integer(static_cast<int64_t>(removed));
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
+    }
+}
+
+// HGETALL key
+// Returns field, value, field, value, ... (empty array if the key does not exist)
+void Handler::handleHGetAll(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        std::vector<std::string> flat = db->hgetall(args[1]);
+        reply.arrayHeader(flat.size());
+        for (const std::string& item : flat) {
+            reply.bulkString(item);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
+    }
+}
+
+// HINCRBY key field increment
+// Adds increment to the integer in field (missing counts as 0). Returns the new value
+void Handler::handleHIncrBy(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        long long increment = parseInteger(args[3]);
+        reply.integer(db->hincrBy(args[1], args[2], increment));
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
+    }
+}
+
+// HLEN key
+// Returns the number of fields, 0 if the key does not exist
+void Handler::handleHLen(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        reply.integer(static_cast<int64_t>(db->hlen(args[1])));
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
+    }
+}
+
+// ZADD key [NX|XX] [GT|LT] [CH] [INCR] score member [score member ...]
+// Adds members or updates their scores. Returns how many were added (CH: added or
+// updated); with INCR, the member's new score, or nil if NX/XX/GT/LT ruled it out
+void Handler::handleZAdd(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        uint32_t flags = 0;
+        bool incr = false;
+        size_t i = 2;
+        for (; i < args.size(); i++) {
+            if (equalsIgnoreCase(args[i], "NX")) flags |= DB::ZADD_NX;
+            else if (equalsIgnoreCase(args[i], "XX")) flags |= DB::ZADD_XX;
+            else if (equalsIgnoreCase(args[i], "GT")) flags |= DB::ZADD_GT;
+            else if (equalsIgnoreCase(args[i], "LT")) flags |= DB::ZADD_LT;
+            else if (equalsIgnoreCase(args[i], "CH")) flags |= DB::ZADD_CH;
+            else if (equalsIgnoreCase(args[i], "INCR")) incr = true;
+            else break;
+        }
+        size_t remaining = args.size() - i;
+        if (remaining == 0 || remaining % 2 != 0) {
+            throw std::runtime_error("syntax error");
+        }
+        if ((flags & DB::ZADD_NX) && (flags & DB::ZADD_XX)) {
+            throw std::runtime_error("XX and NX options at the same time are not compatible");
+        }
+        if (((flags & DB::ZADD_GT) && (flags & DB::ZADD_LT)) ||
+            ((flags & DB::ZADD_NX) && (flags & (DB::ZADD_GT | DB::ZADD_LT)))) {
+            throw std::runtime_error("GT, LT, and/or NX options at the same time are not compatible");
+        }
+        if (incr && remaining != 2) {
+            throw std::runtime_error("INCR option supports a single increment-element pair");
+        }
+
+        // parse every score before touching the set, so a bad one changes nothing
+        std::vector<std::pair<double, std::string_view>> members;
+        members.reserve(remaining / 2);
+        for (; i < args.size(); i += 2) {
+            members.emplace_back(parseScore(args[i]), args[i + 1]);
+        }
+
+        if (incr) {
+            std::optional<double> score = db->zincrBy(args[1], members[0].second, members[0].first, flags);
+            if (score) reply.bulkString(formatScore(*score));
+            else reply.nullBulkString();
+            return;
+        }
+        reply.integer(static_cast<int64_t>(db->zadd(args[1], members, flags)));
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
+    }
+}
+
+// ZINCRBY key increment member
+// Adds increment to member's score (missing counts as 0). Returns the new score
+void Handler::handleZIncrBy(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        double increment = parseScore(args[2]);
+        std::optional<double> score = db->zincrBy(args[1], args[3], increment);
+        reply.bulkString(formatScore(*score));
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
+    }
+}
+
+// ZREM key member [member ...]
+// Removes members, deleting the set once empty. Returns how many were removed
+void Handler::handleZRem(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        size_t removed = db->zrem(args[1], std::span(args).subspan(2));
+        reply.integer(static_cast<int64_t>(removed));
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
+    }
+}
+
+// ZSCORE key member
+// Returns member's score, or nil if the member or the key does not exist
+void Handler::handleZScore(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        std::optional<double> score = db->zscore(args[1], args[2]);
+        if (score) reply.bulkString(formatScore(*score));
+        else reply.nullBulkString();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
+    }
+}
+
+// ZRANK key member
+// Returns member's 0-based rank by ascending score, or nil if it does not exist
+void Handler::handleZRank(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        std::optional<size_t> rank = db->zrank(args[1], args[2]);
+        if (rank) reply.integer(static_cast<int64_t>(*rank));
+        else reply.nullBulkString();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
+    }
+}
+
+// ZCARD key
+// Returns the number of members, 0 if the key does not exist
+void Handler::handleZCard(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        reply.integer(static_cast<int64_t>(db->zcard(args[1])));
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
+    }
+}
+
+// ZRANGE key start stop [WITHSCORES]
+// Returns the members ranked start..stop (inclusive, negative counts from the end),
+// each followed by its score with WITHSCORES
+void Handler::handleZRange(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        bool withScores = args.size() == 5 && equalsIgnoreCase(args[4], "WITHSCORES");
+        if (args.size() > 4 && !withScores) {
+            throw std::runtime_error("syntax error");
+        }
+        long long start = parseInteger(args[2]);
+        long long stop = parseInteger(args[3]);
+
+        std::vector<std::pair<std::string, double>> members = db->zrange(args[1], start, stop);
+        reply.arrayHeader(members.size() * (withScores ? 2 : 1));
+        for (const auto& [member, score] : members) {
+            reply.bulkString(member);
+            if (withScores) reply.bulkString(formatScore(score));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
+    }
+}
+
+// ZRANGEBYSCORE key min max [WITHSCORES] [LIMIT offset count]
+// Returns the members scored between min and max in order ("(" makes a bound exclusive,
+// -inf/+inf leave it open). LIMIT skips offset members and returns at most count, all
+// of them if count is negative
+void Handler::handleZRangeByScore(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        SortedSet::ScoreRange range;
+        range.min = parseScoreBound(args[2], range.minExclusive);
+        range.max = parseScoreBound(args[3], range.maxExclusive);
+
+        bool withScores = false;
+        long long offset = 0;
+        long long count = -1;
+        for (size_t i = 4; i < args.size(); i++) {
+            if (equalsIgnoreCase(args[i], "WITHSCORES")) {
+                withScores = true;
+            } else if (equalsIgnoreCase(args[i], "LIMIT") && i + 2 < args.size()) {
+                offset = parseInteger(args[i + 1]);
+                count = parseInteger(args[i + 2]);
+                i += 2;
+            } else {
+                throw std::runtime_error("syntax error");
+            }
+        }
+
+        std::vector<std::pair<std::string, double>> members;
+        if (offset >= 0) {
+            size_t limit = count < 0 ? SIZE_MAX : static_cast<size_t>(count);
+            members = db->zrangeByScore(args[1], range, static_cast<size_t>(offset), limit);
+        }
+        reply.arrayHeader(members.size() * (withScores ? 2 : 1));
+        for (const auto& [member, score] : members) {
+            reply.bulkString(member);
+            if (withScores) reply.bulkString(formatScore(score));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
+    }
+}
+
+// MEMORY USAGE key [SAMPLES count]  -> bytes held for key, or nil if it does not exist.
+//                                     Sizes are tracked exactly, so SAMPLES is accepted and ignored
+// MEMORY STATS                      -> flat array of name/value pairs
+void Handler::handleMemory(const CommandArgs& args, ReplyBuilder& reply) {
+    try {
+        if (equalsIgnoreCase(args[1], "USAGE")) {
+            if (args.size() != 3 && !(args.size() == 5 && equalsIgnoreCase(args[3], "SAMPLES"))) {
+                throw std::runtime_error("syntax error");
+            }
+            if (args.size() == 5) parseInteger(args[4]);
+            std::optional<size_t> bytes = db->memoryUsage(args[2]);
+            if (bytes) reply.integer(static_cast<int64_t>(*bytes));
+            else reply.nullBulkString();
+        } else if (equalsIgnoreCase(args[1], "STATS")) {
+            DB::MemoryStats stats = db->memoryStats();
+            auto field = [&reply](std::string_view name, size_t value) {
+                reply.bulkString(name);
+                reply.integer(static_cast<int64_t>(value));
+            };
+            reply.arrayHeader(24);
+            field("peak.allocated", stats.peak);
+            field("total.allocated", stats.used);
+            field("dataset.bytes", stats.dataset);
+            field("overhead.hashtable.main", stats.tables);
+            field("overhead.hashtable.expires", stats.expires);
+            field("keys.count", stats.keys);
+            field("keys.bytes-per-key", stats.keys ? stats.used / stats.keys : 0);
+            field("allocator.allocated", stats.allocated);
+            field("allocator.active", stats.active);
+            field("allocator.resident", stats.rss);
+            field("slab.reserved", stats.slabReserved);
+            field("slab.free", stats.slabFree);
+        } else {
+            throw std::runtime_error("unknown subcommand '" + std::string(args[1]) + "'. Try MEMORY USAGE or MEMORY STATS");
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        sendErrorMessage(reply, e.what());
+    }
+}
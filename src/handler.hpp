@@ -6,6 +6,7 @@
 #include <unordered_map>
 #include <mutex>
 #include "resp_parser.hpp" 
+#include "reply_builder.hpp"
 #include "db.hpp"
 
 class Handler {
@@ -13,22 +14,48 @@ public:
     DB* db;  // singleton
     Handler();
 
-    void handleSet(int fd, const std::vector<RESPElement>& requestArray);
-    void handleGet(int fd, const std::vector<RESPElement>& requestArray);
-    void handleExists(int fd, const std::vector<RESPElement>& requestArray);
-    void handleDel(int fd, const std::vector<RESPElement>& requestArray);
-    void handleIncr(int fd, const std::vector<RESPElement>& requestArray);
-    void handleDecr(int fd, const std::vector<RESPElement>& requestArray);
-    void handleLPush(int fd, const std::vector<RESPElement>& requestArray);
-    void handleRPush(int fd, const std::vector<RESPElement>& requestArray);
-    void handleLRange(int fd, const std::vector<RESPElement>& requestArray);
+    void handleSet(const CommandArgs& args, ReplyBuilder& reply);
+    void handleGet(const CommandArgs& args, ReplyBuilder& reply);
+    void handleExists(const CommandArgs& args, ReplyBuilder& reply);
+    void handleDel(const CommandArgs& args, ReplyBuilder& reply);
+    void handleMGet(const CommandArgs& args, ReplyBuilder& reply);
+    void handleMSet(const CommandArgs& args, ReplyBuilder& reply);
+    void handleIncr(const CommandArgs& args, ReplyBuilder& reply);
+    void handleDecr(const CommandArgs& args, ReplyBuilder& reply);
+    void handleIncrBy(const CommandArgs& args, ReplyBuilder& reply);
+    void handleDecrBy(const CommandArgs& args, ReplyBuilder& reply);
+    void handleLPush(const CommandArgs& args, ReplyBuilder& reply);
+    void handleRPush(const CommandArgs& args, ReplyBuilder& reply);
+    void handleLRange(const CommandArgs& args, ReplyBuilder& reply);
+    void handleLPop(const CommandArgs& args, ReplyBuilder& reply);
+    void handleRPop(const CommandArgs& args, ReplyBuilder& reply);
+    void handleLLen(const CommandArgs& args, ReplyBuilder& reply);
+    void handleLIndex(const CommandArgs& args, ReplyBuilder& reply);
+    void handleLTrim(const CommandArgs& args, ReplyBuilder& reply);
+    void handleHSet(const CommandArgs& args, ReplyBuilder& reply);
+    void handleHGet(const CommandArgs& args, ReplyBuilder& reply);
+    void handleHMGet(const CommandArgs& args, ReplyBuilder& reply);
+    void handleHDel(const CommandArgs& args, ReplyBuilder& reply);
+    void handleHGetAll(const CommandArgs& args, ReplyBuilder& reply);
+    void handleHIncrBy(const CommandArgs& args, ReplyBuilder& reply);
+    void handleHLen(const CommandArgs& args, ReplyBuilder& reply);
+    void handleZAdd(const CommandArgs& args, ReplyBuilder& reply);
+    void handleZIncrBy(const CommandArgs& args, ReplyBuilder& reply);
+    void handleZRem(const CommandArgs& args, ReplyBuilder& reply);
+    void handleZScore(const CommandArgs& args, ReplyBuilder& reply);
+    void handleZRank(const CommandArgs& args, ReplyBuilder& reply);
+    void handleZCard(const CommandArgs& args, ReplyBuilder& reply);
+    void handleZRange(const CommandArgs& args, ReplyBuilder& reply);
+    void handleZRangeByScore(const CommandArgs& args, ReplyBuilder& reply);
+    void handleMemory(const CommandArgs& args, ReplyBuilder& reply);
 
     std::string infoReplication();
     std::string toUpper(const std::string& str);
 
 private:
 
-    void sendErrorMessage(int fd, const std::string& errorMessage);
+    void sendErrorMessage(ReplyBuilder& reply, const std::string& errorMessage);
+    void handlePop(const CommandArgs& args, ReplyBuilder& reply, bool fromHead);
 
     bool isReplica;
     int replicaListeningPort;
@@ -0,0 +1,58 @@
+#include "reply_builder.hpp"
+#include <charconv>
+
+// <prefix><number>\r\n, formatted in place without a temporary std::string
+void ReplyBuilder::appendPrefixedNumber(char prefix, int64_t value) {
+    char digits[24];
+    digits[0] = prefix;
+    auto result = std::to_chars(digits + 1, digits + sizeof(digits) - 2, value);
+    result.ptr[0] = '\r';
+    result.ptr[1] = '\n';
+    out_->append(digits, result.ptr + 2 - digits);
+}
+
+void ReplyBuilder::simpleString(std::string_view str) {
+    if (!out_) return;
+    out_->push_back('+');
+    out_->append(str);
+    out_->append("\r\n", 2);
+}
+
+void ReplyBuilder::error(std::string_view message) {
+    if (!out_) return;
+    out_->push_back('-');
+    out_->append(message);
+    out_->append("\r\n", 2);
+}
+
+void ReplyBuilder::integer(int64_t value) {
+    if (!out_) return;
+    appendPrefixedNumber(':', value);
+}
+
+void ReplyBuilder::bulkString(std::string_view str) {
+    if (!out_) return;
+    appendPrefixedNumber('$', static_cast<int64_t>(str.size()));
+    out_->append(str);
+    out_->append("\r\n", 2);
+}
+
+void ReplyBuilder::nullBulkString() {
+    if (!out_) return;
+    out_->append("$-1\r\n", 5);
+}
+
+void ReplyBuilder::nullArray() {
+    if (!out_) return;
+    out_->append("*-1\r\n", 5);
+}
+
+void ReplyBuilder::arrayHeader(size_t count) {
+    if (!out_) return;
+    appendPrefixedNumber('*', static_cast<int64_t>(count));
+}
+
+void ReplyBuilder::raw(std::string_view bytes) {
+    if (!out_) return;
+    out_->append(bytes);
+}
@@ -0,0 +1,33 @@
+#ifndef REPLY_BUILDER_HPP
+#define REPLY_BUILDER_HPP
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+// Appends RESP-encoded replies to an output buffer (normally a connection's write buffer).
+// Handlers never touch sockets; the event loop decides when the buffer is flushed.
+// A default-constructed builder discards everything, for replica apply of master writes.
+class ReplyBuilder {
+public:
+    ReplyBuilder() : out_(nullptr) {}
+    explicit ReplyBuilder(std::string& buffer) : out_(&buffer) {}
+
+    void simpleString(std::string_view str);  // +str\r\n
+    void error(std::string_view message);     // -message\r\n
+    void integer(int64_t value);              // :value\r\n
+    void bulkString(std::string_view str);    // $len\r\nstr\r\n
+    void nullBulkString();                    // $-1\r\n
+    void nullArray();                         // *-1\r\n
+    void arrayHeader(size_t count);           // *count\r\n, followed by count elements
+    void raw(std::string_view bytes);         // already-encoded RESP
+
+    bool discarding() const { return out_ == nullptr; }
+
+private:
+    std::string* out_;
+
+    void appendPrefixedNumber(char prefix, int64_t value);
+};
+
+#endif // REPLY_BUILDER_HPP
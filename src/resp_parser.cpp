@@ -1,88 +1,145 @@
 #include "resp_parser.hpp"
-#include <stdexcept>
-#include <iostream>
-#include <stdexcept>
-#include <iostream>
+#include "crlf_scan.hpp"
 
-std::string RESPParser::readUntilCRLF(const std::string& input) {
-    // Read until the next "\r\n" starting from pos.
-    size_t end = input.find("\r\n", this->pos);
-    if (end == std::string::npos) {
-        // Syntax error: CRLF missing
-        throw std::runtime_error("Syntax error: Missing CRLF");
+#define MAX_BULK_LENGTH (512LL * 1024 * 1024)   // same ceiling as Redis' proto-max-bulk-len
+#define MAX_ARRAY_LENGTH (1024LL * 1024)
+
+namespace {
+    // parse a signed decimal header value without allocating
+    bool parseLength(const char* begin, const char* end, int64_t& out) {
+        if (begin == end) return false;
+        bool negative = *begin == '-';
+        if (negative) begin++;
+        if (begin == end || end - begin > 18) return false;
+
+        int64_t value = 0;
+        for (const char* p = begin; p < end; p++) {
+            if (*p < '0' || *p > '9') return false;
+            value = value * 10 + (*p - '0');
+        }
+        out = negative ? -value : value;
+        return true;
     }
-    std::string result = input.substr(this->pos, end - this->pos);
-    this->pos = end + 2; // Skip past "\r\n"
-    return result;
 }
 
-RESPElement RESPParser::parseRESP(const std::string& input) {
-    if (this->pos >= input.size()) {
-        throw std::runtime_error("Incomplete message: Unexpected end of input");
+ParseStatus RESPParser::fail(const std::string& message) {
+    error = message;
+    return ParseStatus::Error;
+}
+
+void RESPParser::reset() {
+    phase = Phase::ArrayHeader;
+    pos = 0;
+    scanFrom = 0;
+    commandStart = 0;
+    argsRemaining = 0;
+    bulkLength = 0;
+    argSpans.clear();
+    error.clear();
+}
+
+void RESPParser::discardConsumed(std::string& input) {
+    if (commandStart == 0) return;
+    input.erase(0, commandStart);
+    pos -= commandStart;
+    scanFrom -= commandStart;
+    for (auto& span : argSpans) {
+        span.first -= commandStart;
     }
+    commandStart = 0;
+}
 
-    char type = input[this->pos++];  // get symbol
-    RESPElement elem;
+bool RESPParser::readHeader(const std::string& input, char expectedType, int64_t& value, ParseStatus& status) {
+    const size_t size = input.size();
+    if (pos >= size) {
+        status = ParseStatus::NeedMore;
+        return false;
+    }
+    if (input[pos] != expectedType) {
+        status = fail(std::string("Protocol error: expected '") + expectedType + "', got '" + input[pos] + "'");
+        return false;
+    }
 
-    switch (type) {
-        case '+': {  // Simple String, first value read is your string (after advancing pos for symbol)
-            elem.type = RESPType::SimpleString;
-            elem.value = readUntilCRLF(input);
-            break;
-        }
-        case '-': {  // Error
-            elem.type = RESPType::Error;
-            elem.value = readUntilCRLF(input);
-            break;
-        }
-        case ':': {  // Integer
-            elem.type = RESPType::Integer;
-            elem.value = readUntilCRLF(input);
-            break;
-        }
-        case '$': {  // Bulk String
-            elem.type = RESPType::BulkString;
-            // get full header with read until \r\n, know length now from header
-            int length = std::stoi(readUntilCRLF(input));
-            if (length == -1) {
-                elem.type = RESPType::Null;
-                break;
-            }
-            // Check if the input has enough characters for the bulk string.
-            if (this->pos + length > input.size()) {
-                throw std::runtime_error("Incomplete message: Expected bulk string of length " 
-                                           + std::to_string(length) + " bytes, but not all bytes received.");
+    size_t from = scanFrom > pos ? scanFrom : pos + 1;
+    const char* found = from < size ? findCR(input.data() + from, input.data() + size) : nullptr;
+    if (!found) {
+        scanFrom = size;
+        status = ParseStatus::NeedMore;
+        return false;
+    }
+    size_t end = found - input.data();
+    if (end + 1 >= size) {
+        scanFrom = end;  // have '\r', still waiting on '\n'
+        status = ParseStatus::NeedMore;
+        return false;
+    }
+    if (input[end + 1] != '\n') {
+        status = fail("Syntax error: Missing CRLF");
+        return false;
+    }
+    if (!parseLength(input.data() + pos + 1, input.data() + end, value)) {
+        status = fail("Syntax error: invalid number in header");
+        return false;
+    }
+    pos = end + 2;  // Skip past "\r\n"
+    scanFrom = pos;
+    return true;
+}
+
+ParseStatus RESPParser::parse(const std::string& input, CommandArgs& argv) {
+    ParseStatus status = ParseStatus::NeedMore;
+
+    while (true) {
+        switch (phase) {
+            case Phase::ArrayHeader: {
+                int64_t count = 0;
+                if (!readHeader(input, '*', count, status)) return status;
+                if (count > MAX_ARRAY_LENGTH) {
+                    return fail("Syntax error: invalid multibulk length");
+                }
+                if (count <= 0) {  // empty or null command; nothing to run
+                    commandStart = pos;
+                    continue;
+                }
+                argsRemaining = count;
+                argSpans.clear();
+                argSpans.reserve(count);
+                phase = Phase::BulkHeader;
+                continue;
             }
-            // read after \r\n after $number header
-            elem.value = input.substr(this->pos, length);
-            this->pos += length;
-            break;
-        }
-        case '*': {  // Array
-            elem.type = RESPType::Array;
-            int count = std::stoi(readUntilCRLF(input));
-            for (int i = 0; i < count; i++) {
-                if (this->pos >= input.size()) {
-                    throw std::runtime_error("Incomplete message: Expected " + std::to_string(count) 
-                                               + " array elements, but fewer elements found.");
+            case Phase::BulkHeader: {
+                if (!readHeader(input, '$', bulkLength, status)) return status;
+                if (bulkLength < 0 || bulkLength > MAX_BULK_LENGTH) {
+                    return fail("Syntax error: invalid bulk length");
                 }
-                elem.array.push_back(parseRESP(input));
+                phase = Phase::BulkBody;
+                continue;
             }
+            case Phase::BulkBody: {
+                // only the length is checked until the whole payload has arrived
+                if (input.size() - pos < static_cast<size_t>(bulkLength) + 2) return ParseStatus::NeedMore;
+                if (input[pos + bulkLength] != '\r' || input[pos + bulkLength + 1] != '\n') {
+                    return fail("Syntax error: Bulk string not terminated properly with CRLF");
+                }
+                argSpans.emplace_back(pos, bulkLength);
+                pos += bulkLength + 2;  // Skip the trailing CRLF.
+                scanFrom = pos;
 
+                if (--argsRemaining > 0) {
+                    phase = Phase::BulkHeader;
+                    continue;
+                }
+
+                // command complete: hand out views now that the buffer won't move under them
+                argv.clear();
+                argv.reserve(argSpans.size());
+                for (const auto& span : argSpans) {
+                    argv.emplace_back(input.data() + span.first, span.second);
+                }
+                phase = Phase::ArrayHeader;
+                commandStart = pos;
+                return ParseStatus::Ok;
+            }
         }
-        default:
-            throw std::runtime_error("Syntax error: Unknown RESP type");
     }
-    // Verify that item is terminated with CRLF.
-    if (input.substr(this->pos, 2) != "\r\n") {
-        throw std::runtime_error("Incomplete message: Bulk string not terminated properly with CRLF");
-    }
-    this->pos += 2; // Skip the trailing CRLF.
-
-    return elem;
-}
-
-RESPElement RESPParser::parse(const std::string& input) {
-    this->pos = 0;  // reset this->position for new reading
-    return parseRESP(input);
 }
@@ -2,35 +2,60 @@
 #define RESP_PARSER_HPP
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <utility>
+#include <cstdint>
 
-enum class RESPType {
-    SimpleString,
-    BulkString,
-    Integer,
-    Array,
-    Error,
-    Null
-};
+// One client command, argv[0] being the command name. The views point straight into the
+// connection's read buffer: nothing is copied until a handler actually stores a value.
+// They stay valid until that buffer is next modified (appended to or discardConsumed).
+using CommandArgs = std::vector<std::string_view>;
 
-struct RESPElement {
-    RESPType type;
-    std::string value;            // Used for simple strings, errors, and bulk strings
-    std::vector<RESPElement> array; // Used if Array
-    int64_t intValue = 0;           // Used for Integer type
-    RESPElement() = default;
-    explicit RESPElement(RESPType t) : type(t) {}
-    explicit RESPElement(int64_t num) : type(RESPType::Integer), intValue(num) {}
+enum class ParseStatus {
+    Ok,        // one complete command was produced
+    NeedMore,  // input ends mid-command; call again once more bytes are appended
+    Error      // protocol error; see errorMessage(), then reset() and drop the buffer
 };
 
+// Resumable parser for RESP commands (a multibulk array of bulk strings). Keep one per
+// connection: when input ends mid-command the parser remembers how far it got (argument
+// count, bulk length, CRLF scan offset), so each byte is examined once no matter how many
+// reads a command is split across.
 class RESPParser {
 public:
-    RESPElement parse(const std::string& input);
-    
+    // Parse the next command of input, starting where the previous call stopped.
+    // Bytes may only be appended to input between calls (see discardConsumed).
+    ParseStatus parse(const std::string& input, CommandArgs& argv);
+
+    // offset just past the last complete command returned by parse()
+    size_t position() const { return commandStart; }
+
+    // erase fully parsed bytes from the front of input and rebase the in-progress state.
+    // invalidates every CommandArgs handed out so far
+    void discardConsumed(std::string& input);
+
+    // forget any partial command, e.g. after an Error
+    void reset();
+
+    const std::string& errorMessage() const { return error; }
+
 private:
-    size_t pos = 0;
-    std::string readUntilCRLF(const std::string& input);
-    RESPElement parseRESP(const std::string& input);
+    enum class Phase { ArrayHeader, BulkHeader, BulkBody };
+
+    Phase phase = Phase::ArrayHeader;
+    size_t pos = 0;            // next unparsed byte
+    size_t scanFrom = 0;       // CRLF search resumes here, so partial header lines aren't rescanned
+    size_t commandStart = 0;   // start of the command in progress
+    int64_t argsRemaining = 0;
+    int64_t bulkLength = 0;
+    // (offset, length) of each argument parsed so far; offsets survive the buffer reallocating
+    std::vector<std::pair<size_t, size_t>> argSpans;
+    std::string error;
+
+    ParseStatus fail(const std::string& message);
+    // find the CRLF ending the header at pos; false if it hasn't arrived (or on error)
+    bool readHeader(const std::string& input, char expectedType, int64_t& value, ParseStatus& status);
 };
 
 #endif // RESP_PARSER_HPP